@@ -6,10 +6,20 @@
 #include "sys/Timer.h"
 
 #include "sse/sseMath.h"
+#include "sse/sseLut.h"
 
 
 typedef sse4Floats (*ONE_ARG_FUNC)(sse4Floats x);
 typedef sse4Floats (*TWO_ARG_FUNC)(sse4Floats x, sse4Floats y);
+
+// number of segments in each of the lookup tables
+static const int LUT_SEGMENTS = 256;
+
+// lookup tables, built by the compare functions that use them
+static sseLut expLutLinear;
+static sseLut expLutQuadratic;
+static sseLut atanLutLinear;
+static sseLut atanLutQuadratic;
 
 // the 4 positive normals closest to zero, in unsigned integer form
 static const unsigned int initPos[] = {
@@ -54,6 +64,64 @@ forceinline sse4Floats abs_ref_loc(sse4Floats x) {
 	return abs_ref(x);
 }
 
+forceinline sse4Floats trunc_loc(sse4Floats x) {
+	return trunc(x);
+}
+
+forceinline sse4Floats trunc_ref_loc(sse4Floats x) {
+	return trunc_ref(x);
+}
+
+forceinline sse4Floats floor_loc(sse4Floats x) {
+	return floor(x);
+}
+
+forceinline sse4Floats floor_ref_loc(sse4Floats x) {
+	return floor_ref(x);
+}
+
+forceinline sse4Floats ceil_loc(sse4Floats x) {
+	return ceil(x);
+}
+
+forceinline sse4Floats ceil_ref_loc(sse4Floats x) {
+	return ceil_ref(x);
+}
+
+forceinline sse4Floats round_loc(sse4Floats x) {
+	return round(x);
+}
+
+forceinline sse4Floats round_ref_loc(sse4Floats x) {
+	return round_ref(x);
+}
+
+// fmod by fixed divisors, 2*PI and 32.66 both have x for which the
+// single-precision quotient rounds up to an integer
+forceinline sse4Floats fmod_two_pi_loc(sse4Floats x) {
+	return fmod(x, sse4Floats::expand(2.0f * M_PI));
+}
+
+forceinline sse4Floats fmod_two_pi_ref_loc(sse4Floats x) {
+	return fmod_ref(x, sse4Floats::expand(2.0f * M_PI));
+}
+
+forceinline sse4Floats fmod_32_66_loc(sse4Floats x) {
+	return fmod(x, sse4Floats::expand(32.66f));
+}
+
+forceinline sse4Floats fmod_32_66_ref_loc(sse4Floats x) {
+	return fmod_ref(x, sse4Floats::expand(32.66f));
+}
+
+forceinline sse4Floats wrap_angle_loc(sse4Floats x) {
+	return wrap_angle(x);
+}
+
+forceinline sse4Floats wrap_angle_ref_loc(sse4Floats x) {
+	return wrap_angle_ref(x);
+}
+
 forceinline sse4Floats exp_loc(sse4Floats x) {
 	return exp(x);
 }
@@ -86,6 +154,22 @@ forceinline sse4Floats atan_ref_loc(sse4Floats x) {
 	return atan_ref(x);
 }
 
+forceinline sse4Floats exp_lut_lin_loc(sse4Floats x) {
+	return exp_lut(expLutLinear, x);
+}
+
+forceinline sse4Floats exp_lut_quad_loc(sse4Floats x) {
+	return exp_lut(expLutQuadratic, x);
+}
+
+forceinline sse4Floats atan_lut_lin_loc(sse4Floats x) {
+	return atan_lut(atanLutLinear, x);
+}
+
+forceinline sse4Floats atan_lut_quad_loc(sse4Floats x) {
+	return atan_lut(atanLutQuadratic, x);
+}
+
 forceinline sse4Floats atan2_loc(sse4Floats y, sse4Floats x) {
 	return atan2(y, x);
 }
@@ -287,6 +371,50 @@ void compareAbs() {
 	const float BOUND_POS = INF;
 
 	compareFuncs<abs_loc, abs_ref_loc>("abs", BOUND_NEG, BOUND_POS, true);
+}
+
+void compareTrunc() {
+	const float BOUND_NEG = NEGINF;
+	const float BOUND_POS = INF;
+
+	compareFuncs<trunc_loc, trunc_ref_loc>("trunc", BOUND_NEG, BOUND_POS, true);
+}
+
+void compareFloor() {
+	const float BOUND_NEG = NEGINF;
+	const float BOUND_POS = INF;
+
+	compareFuncs<floor_loc, floor_ref_loc>("floor", BOUND_NEG, BOUND_POS, true);
+}
+
+void compareCeil() {
+	const float BOUND_NEG = NEGINF;
+	const float BOUND_POS = INF;
+
+	compareFuncs<ceil_loc, ceil_ref_loc>("ceil", BOUND_NEG, BOUND_POS, true);
+}
+
+void compareRound() {
+	const float BOUND_NEG = NEGINF;
+	const float BOUND_POS = INF;
+
+	compareFuncs<round_loc, round_ref_loc>("round", BOUND_NEG, BOUND_POS, true);
+}
+
+// fmod is exact, so any nonzero maxRelErr is a bug
+void compareFmod() {
+	const float BOUND_NEG = -4096.0f;
+	const float BOUND_POS =  4096.0f;
+
+	compareFuncs<fmod_two_pi_loc, fmod_two_pi_ref_loc>("fmod by 2*PI", BOUND_NEG, BOUND_POS, false);
+	compareFuncs<fmod_32_66_loc,  fmod_32_66_ref_loc> ("fmod by 32.66", BOUND_NEG, BOUND_POS, false);
+}
+
+void compareWrapAngle() {
+	const float BOUND_NEG = -1000.0f;
+	const float BOUND_POS =  1000.0f;
+
+	compareFuncs<wrap_angle_loc, wrap_angle_ref_loc>("wrap_angle", BOUND_NEG, BOUND_POS, false);
 }
 
 void compareExp() {
@@ -317,6 +445,30 @@ void compareAtan() {
 	compareFuncs<atan_loc, atan_ref_loc>("atan", BOUND_NEG, BOUND_POS, true);
 }
 
+// same bounds as compareExp(), so the results can be read side by side
+void compareExpLut() {
+	const float BOUND_NEG = -80.0f;
+	const float BOUND_POS =  80.0f;
+
+	initExpLut(expLutLinear,    LUT_SEGMENTS, LUT_LINEAR);
+	initExpLut(expLutQuadratic, LUT_SEGMENTS, LUT_QUADRATIC);
+
+	compareFuncs<exp_lut_lin_loc,  exp_ref_loc>("exp (linear table)",    BOUND_NEG, BOUND_POS, true);
+	compareFuncs<exp_lut_quad_loc, exp_ref_loc>("exp (quadratic table)", BOUND_NEG, BOUND_POS, true);
+}
+
+// same bounds as compareAtan(), so the results can be read side by side
+void compareAtanLut() {
+	const float BOUND_NEG = NEGINF;
+	const float BOUND_POS = INF;
+
+	initAtanLut(atanLutLinear,    LUT_SEGMENTS, LUT_LINEAR);
+	initAtanLut(atanLutQuadratic, LUT_SEGMENTS, LUT_QUADRATIC);
+
+	compareFuncs<atan_lut_lin_loc,  atan_ref_loc>("atan (linear table)",    BOUND_NEG, BOUND_POS, true);
+	compareFuncs<atan_lut_quad_loc, atan_ref_loc>("atan (quadratic table)", BOUND_NEG, BOUND_POS, true);
+}
+
 
 //--- TWO ARGUMENT FUNCTIONS ---//
 
@@ -4,6 +4,18 @@
 
 void compareAbs();
 
+void compareTrunc();
+
+void compareFloor();
+
+void compareCeil();
+
+void compareRound();
+
+void compareFmod();
+
+void compareWrapAngle();
+
 void compareExp();
 
 void compareSin();
@@ -12,6 +24,10 @@ void compareCos();
 
 void compareAtan();
 
+void compareExpLut();
+
+void compareAtanLut();
+
 void compareAtan2();
 
 void compareOldAtan2();
@@ -1,9 +1,14 @@
 // draws the graphical interface
 
+#include <float.h>
 #include <stdio.h>
 
 #include "GL/glut.h"
 
+#include "sys/PerfCounters.h"
+#include "sys/Profiler.h"
+#include "sys/Trace.h"
+
 #include "pf.h"
 
 
@@ -23,6 +28,10 @@ static const int INIT_Y_POS = 30;
 
 static const char *WINDOW_NAME = "pf";
 
+// where 't' writes the timeline, and how many zone passes it holds
+static const char *TRACE_FILENAME = "pf_trace.json";
+static const int TRACE_MAX_EVENTS = 1 << 20;
+
 // particles with a color intensity below this threshold are not drawn,
 // if color inversion is enabled this is the threshold pre-inversion
 static const float PARTICLE_COLOR_THRESHOLD = 0.01f;
@@ -70,15 +79,14 @@ const char *SD_MODE_STRINGS[] = {
 
 //--- LOADED FROM EXTERNAL MODULE ---//
 
+static ParticleFilter *pf;		// the filter being shown
 static Rectangle field;
 static Rectangle grass;
 static RobotPose actualPose;
-static Observation *observations;
+static const Observation *observations;
 static ObservationWindow *obsWindow;
 static const Point2D *refObjs;
 static int numRefObjs;
-static ParticleArray particles;
-static ParticleArray_4Wide particles_4Wide;
 
 
 //--- GLOBALS ---//
@@ -102,6 +110,8 @@ static RobotPose estPose;
 // fps from the last invocation of the particle filter
 static float pfFps;
 
+static ProfileZone zoneDraw("draw");
+
 
 //--- FUNCTIONS ---//
 
@@ -111,10 +121,15 @@ float alwaysZero(const ProbabilityExponents &pe) {
 	return 0.0f;
 }
 
-// cycles through the display modes round-robin
+// cycles through the display modes round-robin, the distance and bearing
+// alone are skipped unless the filter keeps them apart, see
+// PfConfig::splitExponents
 static
 SimilarityDisplayMode getNext(SimilarityDisplayMode mode) {
-	return (SimilarityDisplayMode)((mode + 1) % NUM_SD_MODES);
+	do {
+		mode = (SimilarityDisplayMode)((mode + 1) % NUM_SD_MODES);
+	} while ((mode == SD_DISTANCE || mode == SD_BEARING) && !pf->getConfig().splitExponents);
+	return mode;
 }
 
 static
@@ -156,15 +171,14 @@ void oneTimeInit() {
 	init = true;
 
 	// load all static particle filter state
-	field = getField();
-	grass = getGrass();
+	const FieldMap &map = pf->getMap();
+	field = map.field;
+	grass = map.grass;
 	actualPose = getActualPose();
-	observations = getObservations();
-	obsWindow = getObservationWindow();
-	refObjs = getReferenceObjects();
-	numRefObjs = getNumReferenceObjects();
-	particles = getParticles();
-	particles_4Wide = getParticles_4Wide();
+	observations = pf->getObservations();
+	obsWindow = &pf->getObservationWindow();
+	refObjs = map.refObjs;
+	numRefObjs = map.numRefObjs;
 
 	updateWindowSizeState(windowWidth, windowHeight);
 
@@ -295,56 +309,6 @@ void drawGrass() {
 	glEnd();
 }
 
-static
-void drawParticlesScalar(float (*peFunc)(const ProbabilityExponents &pe)) {
-	// draw all of the particle locations as points,
-	// draw all of the particle directions as vectors
-	for (int i = 0; i < particles.n; i++) {
-		float x = peFunc(particles.e[i]);
-		float color = exp(x);
-
-		if (color < PARTICLE_COLOR_THRESHOLD) {
-			continue;
-		}
-#if INVERTED_COLORS
-		color = 1.0f - color;
-#endif
-
-		Particle &p = particles.p[i];
-		Point2D pos = p.pos;
-		AngRad  ang = p.ang;
-
-		drawMidVector(pos.x, pos.y, ang, color, color, color);
-		drawSmallPoint(pos.x, pos.y, color, color, color);
-	}
-}
-
-static
-void drawParticlesSse(float (*peFunc)(const ProbabilityExponents &pe)) {
-	for (int i = 0; i < particles_4Wide.n; i++) {		// index of the 4-wide
-		Particle_4Wide part4 = particles_4Wide.p[i];
-		ProbabilityExponents_4Wide e4 = particles_4Wide.e[i];
-
-		for (int j = 0; j < SSE_WIDTH; j++)  {			// index into the current 4-wide
-			float x = peFunc(e4[j]);
-			float color = exp(x);
-
-			if (color < PARTICLE_COLOR_THRESHOLD) {
-				continue;
-			}
-#if INVERTED_COLORS
-			color = 1.0f - color;
-#endif
-
-			Point2D pos = part4.pos[j];
-			AngRad  ang = part4.ang[j];
-
-			drawMidVector(pos.x, pos.y, ang, color, color, color);
-			drawSmallPoint(pos.x, pos.y, color, color, color);
-		}
-	}
-}
-
 static
 void drawParticles() {
 	// hook up the probability exponent function pointer based
@@ -371,10 +335,33 @@ void drawParticles() {
 			error("unknown similarity display mode");
 	}
 
-	if (getPfMode() == PF_SCALAR) {
-		drawParticlesScalar(peFunc);
-	} else {
-		drawParticlesSse(peFunc);
+	// the exponents are far below 0 on large windows, so the colors are
+	// over the weight of the largest, as the filter's weights are
+	int n = pf->getNumParticles();
+	float maxExp = -FLT_MAX;
+	for (int i = 0; i < n; i++) {
+		maxExp = max(maxExp, peFunc(pf->getProbabilityExponents(i)));
+	}
+
+	// draw all of the particle locations as points,
+	// draw all of the particle directions as vectors
+	for (int i = 0; i < n; i++) {
+		float x = peFunc(pf->getProbabilityExponents(i));
+		float color = exp(x - maxExp);
+
+		if (color < PARTICLE_COLOR_THRESHOLD) {
+			continue;
+		}
+#if INVERTED_COLORS
+		color = 1.0f - color;
+#endif
+
+		Particle p = pf->getParticle(i);
+		Point2D pos = p.pos;
+		AngRad  ang = p.ang;
+
+		drawMidVector(pos.x, pos.y, ang, color, color, color);
+		drawSmallPoint(pos.x, pos.y, color, color, color);
 	}
 }
 
@@ -400,7 +387,7 @@ void drawObservations() {
 	int n = obsWindow->getSize();
 
 	for (int i = 0; i < n; i++) {
-		Observation &o = observations[b + i];
+		const Observation &o = observations[b + i];
 		const Point2D &p = refObjs[o.id];
 
 		drawCircle(p.x, p.y, o.d, OBS_COLOR[0], OBS_COLOR[1], OBS_COLOR[2]);
@@ -484,6 +471,7 @@ void drawHud() {
 	float font_h     = 10.0f * worldPerWindow;
 	float upper_row1 = 0.93f * windowHeight * worldPerWindow;
 	float upper_row2 = upper_row1 - (spacing + font_h)*2.0f;
+	float upper_row3 = upper_row2 - (spacing + font_h)*2.0f;
 	float lower_row2 = -0.95f * windowHeight * worldPerWindow;
 	float lower_row1 = lower_row2 + (spacing + font_h)*2.0f;
 
@@ -498,14 +486,18 @@ void drawHud() {
 	float vert_spacer = spacing;
 
 	// pf mode and num particles (upper left)
-	int n = (getPfMode() == PF_SCALAR) ? particles.n : particles_4Wide.n * SSE_WIDTH;
-	sprintf(msg, "%s particle filter [%d particles]", getPfModeString(), n);
+	sprintf(msg, "%s particle filter [%d particles]", pf->getModeString(), pf->getNumParticles());
 	drawString(msg, left, upper_row1);
 
 	// fps (upper left)
 	sprintf(msg, "inner loop fps: %.1f", pfFps);
 	drawString(msg, left, upper_row2);
 
+	// effective sample size and how often 'a' resampled (upper left)
+	sprintf(msg, "effective sample size: %.0f, resampled: %.0f%%",
+			max(pf->getEffectiveSampleSize(), 0.0f), pf->getResampleRate() * 100.0f);
+	drawString(msg, left, upper_row3);
+
 	// observation num and window size (lower left)
 	sprintf(msg, "[observation %d] window size: %d",
 			obsWindow->getBase(), obsWindow->getSize());
@@ -556,8 +548,10 @@ void drawCb() {
 	oneTimeInit();
 
 	// invoke the particle filter
-	estPose = runPf();
-	pfFps = getLastPfFps();
+	estPose = pf->run();
+	pfFps = pf->getLastFps();
+
+	PROFILE_ZONE(zoneDraw);
 
 	glClear(GL_COLOR_BUFFER_BIT);
 	drawScene();
@@ -585,7 +579,34 @@ void keyboardCb(unsigned char c, int x, int y) {
 		// toggle the particle filter mode
 		case '`':
 		case '~':
-			togglePfMode();
+			pf->toggleMode();
+			glutPostRedisplay();
+			break;
+
+		// halve or double the number of particles, which are placed anew
+		case '-':
+		case '_':
+			pf->initParticles(max(pf->getNumParticles() / 2, 1));
+			glutPostRedisplay();
+			break;
+
+		case '=':
+		case '+':
+			pf->initParticles(min(pf->getNumParticles() * 2, MAX_NUM_PARTICLES));
+			glutPostRedisplay();
+			break;
+
+		// go to the next observation and move the particles by its odometry
+		case 'a':
+		case 'A':
+			pf->advance();
+			glutPostRedisplay();
+			break;
+
+		// draw a new set of particles in proportion to their probability
+		case 's':
+		case 'S':
+			pf->resample();
 			glutPostRedisplay();
 			break;
 
@@ -595,6 +616,44 @@ void keyboardCb(unsigned char c, int x, int y) {
 			glutPostRedisplay();
 			break;
 
+		// print the time spent in each stage of the particle filter
+		case 'p':
+		case 'P':
+			dumpProfileZones(stdout);
+			printf("\n");
+			break;
+
+		// print the hardware counters of the hot loops
+		case 'c':
+		case 'C':
+			dumpPerfRegions(stdout);
+			printf("\n");
+			break;
+
+		// start the stage timings and counters over
+		case 'r':
+		case 'R':
+			resetProfileZones();
+			resetPerfRegions();
+			break;
+
+		// start recording a timeline, or stop and write it out
+		case 't':
+		case 'T':
+			if (!isTracing()) {
+				startTrace(TRACE_MAX_EVENTS);
+				printf("recording timeline\n");
+			} else {
+				stopTrace();
+				if (writeTrace(TRACE_FILENAME)) {
+					printf("wrote %d events to \"%s\" (%d dropped)\n", getNumTraceEvents(),
+						   TRACE_FILENAME, getNumDroppedTraceEvents());
+				} else {
+					printf("could not open \"%s\"\n", TRACE_FILENAME);
+				}
+			}
+			break;
+
 		default:
 			break;
 	}
@@ -632,7 +691,9 @@ void spKeyboardCb(int c, int x, int y) {
 	}
 }
 
-void initWindow(int argc, char **argv) {
+void initWindow(int argc, char **argv, ParticleFilter *in_pf) {
+	pf = in_pf;
+
 	// using these functions to suppress the unreferenced func warning
 	(void)glutCreateMenu;
 
@@ -2,7 +2,10 @@
 
 // draws the graphical interface
 
-void initWindow(int argc, char **argv);
+class ParticleFilter;
+
+// shows the filter, which must outlive the window
+void initWindow(int argc, char **argv, ParticleFilter *pf);
 
 void closeWindow();
 
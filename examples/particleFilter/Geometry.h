@@ -1,89 +1,124 @@
 #pragma once
 
-// basic geometry objects, scalar version
+// basic geometry objects, any lane width (see Lanes.h)
 
 #include <math.h>
 
 #include "sys/common.h"
 #include "sys/sysMath.h"
 
+#include "Lanes.h"
+
 
 typedef float AngRad;
 
 
-class Point2D {
+template <class F>
+class Point2D_Wide {
+private:
+	typedef Lanes<F> L;
+
 public:
-	float x; /*!< x-coordinate of this position */
-	float y; /*!< y-coordinate of this position */
+	F x; /*!< x-coordinates of these positions */
+	F y; /*!< y-coordinates of these positions */
 
 
 	//--- STATIC CLASS METHODS ---//
 
-	static forceinline Point2D fromPolar(float mag, AngRad ang) {
+	static forceinline Point2D_Wide fromPolar(F mag, F ang) {
 		// cos(phi) = x/r <=> x = r*cos(phi)
 		// sin(phi) = y/r <=> y = r*sin(phi)
-		return Point2D(mag * cosf(ang), mag * sinf(ang));
+		return Point2D_Wide(mag * L::cos(ang), mag * L::sin(ang));
+	}
+
+	// converts a 1-wide into a wide via expansion
+	static forceinline Point2D_Wide expand(const Point2D_Wide<float> &in) {
+		return Point2D_Wide(L::expand(in.x), L::expand(in.y));
 	}
 
 
 	//--- CONSTRUCTORS ---//
 
-	forceinline Point2D()
-		: x(0.0f), y(0.0f) {}
+	forceinline Point2D_Wide()
+		: x(L::zeros()), y(L::zeros()) {}
 
-	forceinline Point2D(float in_x, float in_y)
+	forceinline Point2D_Wide(F in_x, F in_y)
 		: x(in_x), y(in_y) {}
 
+	// extract an element from the wide
+	forceinline Point2D_Wide<float> operator [](int index) const {
+		return Point2D_Wide<float>(L::get(x, index), L::get(y, index));
+	}
+
 
 	//--- ARITHMETIC OPERATORS ---//
 
-	forceinline Point2D operator -(const Point2D &rhs) const {
-		return Point2D(x - rhs.x, y - rhs.y);
+	forceinline Point2D_Wide operator +(const Point2D_Wide &rhs) const {
+		return Point2D_Wide(x + rhs.x, y + rhs.y);
 	}
 
-	forceinline Point2D operator *(const Point2D &rhs) const {
-		return Point2D(x * rhs.x, y * rhs.y);
+	forceinline Point2D_Wide operator -(const Point2D_Wide &rhs) const {
+		return Point2D_Wide(x - rhs.x, y - rhs.y);
 	}
 
-	forceinline Point2D operator *(float d) const {
-		return Point2D(x * d, y * d);
+	forceinline Point2D_Wide operator *(const Point2D_Wide &rhs) const {
+		return Point2D_Wide(x * rhs.x, y * rhs.y);
 	}
 
-	forceinline Point2D &operator += (const Point2D &rhs) {
+	forceinline Point2D_Wide operator /(const Point2D_Wide &rhs) const {
+		return Point2D_Wide(x / rhs.x, y / rhs.y);
+	}
+
+	forceinline Point2D_Wide operator *(F d) const {
+		return Point2D_Wide(x * d, y * d);
+	}
+
+	forceinline Point2D_Wide &operator += (const Point2D_Wide &rhs) {
 		x += rhs.x;
 		y += rhs.y;
 		return *this;
 	}
 
+	//--- REDUCTION ---//
+
+	forceinline Point2D_Wide<float> reduce_add() const {
+		return Point2D_Wide<float>(L::reduce_add(x), L::reduce_add(y));
+	}
+
 	//--- VECTOR OPERATIONS ---//
 
-	forceinline float getMagnitude() const {
-		return sqrtf(x*x + y*y);
+	forceinline F getMagnitude() const {
+		return L::sqrt(x*x + y*y);
 	}
 
-	forceinline AngRad getDirection() const {
-		return atan2f(y, x);
+	forceinline F getDirection() const {
+		return L::atan2(y, x);
 	}
 
-	forceinline float getDistanceTo(const Point2D &rhs) const {
+	forceinline F getDistanceTo(const Point2D_Wide &rhs) const {
 		return (*this - rhs).getMagnitude();
 	}
 
 	//--- I/O ---//
 	void println() const {
-		printf("(%f, %f)\n", x, y);
+		for (int i = 0; i < L::WIDTH; i++) {
+			printf("(%f, %f)\n", L::get(x, i), L::get(y, i));
+		}
 	}
 };
 
 
 // component-wise sqrt
+template <class F>
 static forceinline
-Point2D sqrt(const Point2D &p) {
-	return Point2D(sqrtf(p.x), sqrtf(p.y));
+Point2D_Wide<F> sqrt(const Point2D_Wide<F> &p) {
+	return Point2D_Wide<F>(Lanes<F>::sqrt(p.x), Lanes<F>::sqrt(p.y));
 }
 
 
-typedef Point2D Vector2D;
+// treat 2D points and vectors similarly
+typedef Point2D_Wide<float> Point2D;
+typedef Point2D             Vector2D;
 
 
 class Rectangle {
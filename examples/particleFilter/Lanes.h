@@ -0,0 +1,496 @@
+#pragma once
+
+// lane types for the width-generic particle filter
+//
+// the filter is written once as templates over a lane type F, which holds
+// Lanes<F>::WIDTH floats that are processed together:
+//
+//   float        - 1 lane, the scalar version
+//   sse4Floats   - 4 lanes, one SSE register
+//   sse8Floats   - 8 lanes, two SSE registers
+//   sse16Floats  - 16 lanes, four SSE registers
+//
+// the arithmetic operators work on every lane type, anything else the
+// filter needs goes through Lanes<F>, which keeps the overloads for
+// float, which would otherwise pick up the double and int versions in
+// math.h and stdlib.h, out of the way
+//
+// the 8- and 16-wide types are built from SSE2 registers, processing 2 or
+// 4 registers per step to hide the latency of the longer math routines, a
+// native 256- or 512-bit type only needs its own Lanes specialization
+
+#include <math.h>
+
+#include "sys/common.h"
+#include "sys/sysMath.h"
+
+#include "sse/sseMath.h"
+
+
+//--- WIDE SSE LANES ---//
+
+// N masks, kept as N / SSE_WIDTH SSE masks
+template <int N>
+class sseMasks {
+public:
+	static const int PARTS = N / SSE_WIDTH;
+
+	sseMask part[PARTS];
+
+	forceinline sseMasks operator &(const sseMasks &rhs) const {
+		sseMasks r;
+		for (int i = 0; i < PARTS; i++) {
+			r.part[i] = part[i] & rhs.part[i];
+		}
+		return r;
+	}
+
+	forceinline sseMasks operator |(const sseMasks &rhs) const {
+		sseMasks r;
+		for (int i = 0; i < PARTS; i++) {
+			r.part[i] = part[i] | rhs.part[i];
+		}
+		return r;
+	}
+};
+
+// N floats, kept as N / SSE_WIDTH SSE registers
+template <int N>
+class sseFloats {
+public:
+	static const int PARTS = N / SSE_WIDTH;
+
+	sse4Floats part[PARTS];
+
+	//--- ARITHMETIC ---//
+	forceinline sseFloats operator +(const sseFloats &rhs) const {
+		sseFloats r;
+		for (int i = 0; i < PARTS; i++) {
+			r.part[i] = part[i] + rhs.part[i];
+		}
+		return r;
+	}
+
+	forceinline sseFloats operator -(const sseFloats &rhs) const {
+		sseFloats r;
+		for (int i = 0; i < PARTS; i++) {
+			r.part[i] = part[i] - rhs.part[i];
+		}
+		return r;
+	}
+
+	forceinline sseFloats operator *(const sseFloats &rhs) const {
+		sseFloats r;
+		for (int i = 0; i < PARTS; i++) {
+			r.part[i] = part[i] * rhs.part[i];
+		}
+		return r;
+	}
+
+	forceinline sseFloats operator /(const sseFloats &rhs) const {
+		sseFloats r;
+		for (int i = 0; i < PARTS; i++) {
+			r.part[i] = part[i] / rhs.part[i];
+		}
+		return r;
+	}
+
+	forceinline sseFloats operator -() const {
+		sseFloats r;
+		for (int i = 0; i < PARTS; i++) {
+			r.part[i] = -part[i];
+		}
+		return r;
+	}
+
+	//--- ASSIGNMENT ---//
+	forceinline sseFloats &operator +=(const sseFloats &rhs) {
+		operator =(operator +(rhs)); return *this;
+	}
+
+	//--- COMPARISON ---//
+	forceinline sseMasks<N> operator <(const sseFloats &rhs) const {
+		sseMasks<N> r;
+		for (int i = 0; i < PARTS; i++) {
+			r.part[i] = part[i] < rhs.part[i];
+		}
+		return r;
+	}
+
+	forceinline sseMasks<N> operator <=(const sseFloats &rhs) const {
+		sseMasks<N> r;
+		for (int i = 0; i < PARTS; i++) {
+			r.part[i] = part[i] <= rhs.part[i];
+		}
+		return r;
+	}
+
+	forceinline sseMasks<N> operator >(const sseFloats &rhs) const {
+		sseMasks<N> r;
+		for (int i = 0; i < PARTS; i++) {
+			r.part[i] = part[i] > rhs.part[i];
+		}
+		return r;
+	}
+
+	forceinline sseMasks<N> operator >=(const sseFloats &rhs) const {
+		sseMasks<N> r;
+		for (int i = 0; i < PARTS; i++) {
+			r.part[i] = part[i] >= rhs.part[i];
+		}
+		return r;
+	}
+};
+
+typedef sseFloats<8>  sse8Floats;
+typedef sseFloats<16> sse16Floats;
+
+
+//--- LANE OPERATIONS ---//
+
+template <class F>
+struct Lanes;
+
+// 1 lane, the scalar version
+template <>
+struct Lanes<float> {
+	typedef bool Mask;
+
+	static const int WIDTH = 1;
+
+	static forceinline float zeros() {
+		return 0.0f;
+	}
+
+	static forceinline float expand(float f) {
+		return f;
+	}
+
+	// reads WIDTH consecutive floats, no alignment needed
+	static forceinline float load(const float *src) {
+		return *src;
+	}
+
+	// writes WIDTH consecutive floats, no alignment needed
+	static forceinline void store(float *dst, float v) {
+		*dst = v;
+	}
+
+	static forceinline float get(float v, int index) {
+		assert(index == 0);
+		return v;
+	}
+
+	// the first count lanes are on, the rest are off
+	static forceinline bool firstLanes(int count) {
+		return count > 0;
+	}
+
+	static forceinline float blend(bool mask, float arg_true, float arg_false) {
+		return mask ? arg_true : arg_false;
+	}
+
+	// whether any lane of the mask is on
+	static forceinline bool any(bool mask) {
+		return mask;
+	}
+
+	static forceinline float max(float a, float b) {
+		return ::max(a, b);
+	}
+
+	static forceinline float abs(float x) {
+		return fabsf(x);
+	}
+
+	static forceinline float sqrt(float x) {
+		return sqrtf(x);
+	}
+
+	static forceinline float exp(float x) {
+		return expf(x);
+	}
+
+	static forceinline float sin(float x) {
+		return sinf(x);
+	}
+
+	static forceinline float cos(float x) {
+		return cosf(x);
+	}
+
+	static forceinline void sincos(float x, float &s, float &c) {
+		s = sinf(x);
+		c = cosf(x);
+	}
+
+	static forceinline float atan2(float y, float x) {
+		return atan2f(y, x);
+	}
+
+	static forceinline float reduce_add(float v) {
+		return v;
+	}
+
+	static forceinline float reduce_max(float v) {
+		return v;
+	}
+
+	static forceinline bool inbounds(float v, float lo, float hi) {
+		return ::inbounds(v, lo, hi);
+	}
+};
+
+// 4 lanes, one SSE register
+template <>
+struct Lanes<sse4Floats> {
+	typedef sseMask Mask;
+
+	static const int WIDTH = SSE_WIDTH;
+
+	static forceinline sse4Floats zeros() {
+		return sse4Floats::zeros();
+	}
+
+	static forceinline sse4Floats expand(float f) {
+		return sse4Floats::expand(f);
+	}
+
+	// reads WIDTH consecutive floats, no alignment needed
+	static forceinline sse4Floats load(const float *src) {
+		return _mm_loadu_ps(src);
+	}
+
+	// writes WIDTH consecutive floats, no alignment needed
+	static forceinline void store(float *dst, const sse4Floats &v) {
+		_mm_storeu_ps(dst, v.data);
+	}
+
+	static forceinline float get(const sse4Floats &v, int index) {
+		return v[index];
+	}
+
+	// the first count lanes are on, the rest are off
+	static forceinline sseMask firstLanes(int count) {
+		return sse4Floats(0.0f, 1.0f, 2.0f, 3.0f) < sse4Floats::expand((float)count);
+	}
+
+	static forceinline sse4Floats blend(const sseMask &mask,
+										const sse4Floats &arg_true,
+										const sse4Floats &arg_false)
+	{
+		return blend4(mask, arg_true, arg_false);
+	}
+
+	static forceinline bool any(const sseMask &mask) {
+		return ::any(mask);
+	}
+
+	static forceinline sse4Floats max(const sse4Floats &a, const sse4Floats &b) {
+		return max4(a, b);
+	}
+
+	static forceinline sse4Floats abs(const sse4Floats &x) {
+		return ::abs(x);
+	}
+
+	static forceinline sse4Floats sqrt(const sse4Floats &x) {
+		return ::sqrt(x);
+	}
+
+	static forceinline sse4Floats exp(const sse4Floats &x) {
+		return ::exp(x);
+	}
+
+	static forceinline sse4Floats sin(const sse4Floats &x) {
+		return ::sin(x);
+	}
+
+	static forceinline sse4Floats cos(const sse4Floats &x) {
+		return ::cos(x);
+	}
+
+	static forceinline void sincos(const sse4Floats &x, sse4Floats &s, sse4Floats &c) {
+		::sincos(x, s, c);
+	}
+
+	static forceinline sse4Floats atan2(const sse4Floats &y, const sse4Floats &x) {
+		return ::atan2(y, x);
+	}
+
+	static forceinline float reduce_add(const sse4Floats &v) {
+		return v.reduce_add();
+	}
+
+	static forceinline float reduce_max(const sse4Floats &v) {
+		return v.reduce_max();
+	}
+
+	static forceinline bool inbounds(const sse4Floats &v, float lo, float hi) {
+		return ::inbounds(v, lo, hi);
+	}
+};
+
+// 8 or 16 lanes, every operation is applied to each SSE register in turn
+template <int N>
+struct Lanes< sseFloats<N> > {
+	typedef sseFloats<N> F;
+	typedef sseMasks<N>  Mask;
+
+	static const int WIDTH = N;
+	static const int PARTS = F::PARTS;
+
+	static forceinline F zeros() {
+		F r;
+		for (int i = 0; i < PARTS; i++) {
+			r.part[i] = sse4Floats::zeros();
+		}
+		return r;
+	}
+
+	static forceinline F expand(float f) {
+		F r;
+		for (int i = 0; i < PARTS; i++) {
+			r.part[i] = sse4Floats::expand(f);
+		}
+		return r;
+	}
+
+	// reads WIDTH consecutive floats, no alignment needed
+	static forceinline F load(const float *src) {
+		F r;
+		for (int i = 0; i < PARTS; i++) {
+			r.part[i] = _mm_loadu_ps(src + i * SSE_WIDTH);
+		}
+		return r;
+	}
+
+	// writes WIDTH consecutive floats, no alignment needed
+	static forceinline void store(float *dst, const F &v) {
+		for (int i = 0; i < PARTS; i++) {
+			_mm_storeu_ps(dst + i * SSE_WIDTH, v.part[i].data);
+		}
+	}
+
+	static forceinline float get(const F &v, int index) {
+		assert(index >= 0 && index < WIDTH);
+		return v.part[index / SSE_WIDTH][index % SSE_WIDTH];
+	}
+
+	// the first count lanes are on, the rest are off
+	static forceinline Mask firstLanes(int count) {
+		Mask r;
+		for (int i = 0; i < PARTS; i++) {
+			r.part[i] = Lanes<sse4Floats>::firstLanes(count - i * SSE_WIDTH);
+		}
+		return r;
+	}
+
+	static forceinline F blend(const Mask &mask, const F &arg_true, const F &arg_false) {
+		F r;
+		for (int i = 0; i < PARTS; i++) {
+			r.part[i] = blend4(mask.part[i], arg_true.part[i], arg_false.part[i]);
+		}
+		return r;
+	}
+
+	// the masks are or'ed first, then the lanes of the result
+	static forceinline bool any(const Mask &mask) {
+		sseMask r = mask.part[0];
+		for (int i = 1; i < PARTS; i++) {
+			r = r | mask.part[i];
+		}
+		return ::any(r);
+	}
+
+	static forceinline F max(const F &a, const F &b) {
+		F r;
+		for (int i = 0; i < PARTS; i++) {
+			r.part[i] = max4(a.part[i], b.part[i]);
+		}
+		return r;
+	}
+
+	static forceinline F abs(const F &x) {
+		F r;
+		for (int i = 0; i < PARTS; i++) {
+			r.part[i] = ::abs(x.part[i]);
+		}
+		return r;
+	}
+
+	static forceinline F sqrt(const F &x) {
+		F r;
+		for (int i = 0; i < PARTS; i++) {
+			r.part[i] = ::sqrt(x.part[i]);
+		}
+		return r;
+	}
+
+	static forceinline F exp(const F &x) {
+		F r;
+		for (int i = 0; i < PARTS; i++) {
+			r.part[i] = ::exp(x.part[i]);
+		}
+		return r;
+	}
+
+	static forceinline F sin(const F &x) {
+		F r;
+		for (int i = 0; i < PARTS; i++) {
+			r.part[i] = ::sin(x.part[i]);
+		}
+		return r;
+	}
+
+	static forceinline F cos(const F &x) {
+		F r;
+		for (int i = 0; i < PARTS; i++) {
+			r.part[i] = ::cos(x.part[i]);
+		}
+		return r;
+	}
+
+	static forceinline void sincos(const F &x, F &s, F &c) {
+		for (int i = 0; i < PARTS; i++) {
+			::sincos(x.part[i], s.part[i], c.part[i]);
+		}
+	}
+
+	static forceinline F atan2(const F &y, const F &x) {
+		F r;
+		for (int i = 0; i < PARTS; i++) {
+			r.part[i] = ::atan2(y.part[i], x.part[i]);
+		}
+		return r;
+	}
+
+	// the registers are summed first, then the lanes of the total
+	static forceinline float reduce_add(const F &v) {
+		sse4Floats total = v.part[0];
+		for (int i = 1; i < PARTS; i++) {
+			total += v.part[i];
+		}
+		return total.reduce_add();
+	}
+
+	static forceinline float reduce_max(const F &v) {
+		sse4Floats top = v.part[0];
+		for (int i = 1; i < PARTS; i++) {
+			top = max4(top, v.part[i]);
+		}
+		return top.reduce_max();
+	}
+
+	static forceinline bool inbounds(const F &v, float lo, float hi) {
+		for (int i = 0; i < PARTS; i++) {
+			if (!::inbounds(v.part[i], lo, hi)) {
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+
+// end of Lanes.h
@@ -1,6 +1,6 @@
 #pragma once
 
-// basic particle, scalar version
+// basic particle, any lane width (see Lanes.h)
 
 #include <math.h>
 
@@ -9,35 +9,84 @@
 
 #include "Geometry.h"
 #include "Angle.h"
+#include "Lanes.h"
 
 
-class Particle {
+template <class F>
+class Particle_Wide {
+private:
+	typedef Lanes<F> L;
+
 public:
-	Point2D pos;
-	AngRad  ang;
+	Point2D_Wide<F> pos;
+	F               ang;
+
+	forceinline Particle_Wide() {}
+
+	// angles must be in the range [-PI, PI]
+	forceinline Particle_Wide(Point2D_Wide<F> in_pos, F in_ang)
+		: pos(in_pos), ang(in_ang)
+	{
+		assert(L::inbounds(ang, -M_PI, M_PI));
+	}
 
-	forceinline void placeRandomly(const Rectangle &bounds) {
+	// gathers count 1-wide particles into a wide, count is on [1, WIDTH],
+	// lanes past count repeat the last particle so they stay finite
+	forceinline Particle_Wide(const Particle_Wide<float> *in, int count) {
+		assert(count >= 1 && count <= L::WIDTH);
+
+		float x[L::WIDTH];
+		float y[L::WIDTH];
+		float a[L::WIDTH];
+
+		for (int i = 0; i < L::WIDTH; i++) {
+			int j = (i < count) ? i : count - 1;
+			x[i] = in[j].pos.x;
+			y[i] = in[j].pos.y;
+			a[i] = in[j].ang;
+		}
+
+		pos = Point2D_Wide<F>(L::load(x), L::load(y));
+		ang = L::load(a);
+		assert(L::inbounds(ang, -M_PI, M_PI));
+	}
+
+	// converts a 1-wide into a wide via expansion
+	static forceinline Particle_Wide expand(const Particle_Wide<float> &in) {
+		return Particle_Wide(Point2D_Wide<F>::expand(in.pos), L::expand(in.ang));
+	}
+
+	// extract an element from the wide
+	forceinline Particle_Wide<float> operator [](int index) const {
+		return Particle_Wide<float>(pos[index], L::get(ang, index));
+	}
+
+	// 1-wide only
+	forceinline void placeRandomly(const Rectangle &bounds, RandGen &rng) {
 		Point2D bl = bounds.getBottomLeft();
 
 		// generate a random point within the boundary
-		pos = Point2D(getRand(bl.x, bounds.getWidth()),
-					  getRand(bl.y, bounds.getHeight()));
-		ang = getRand(-M_PI, 2.0 * M_PI);		// [-PI, PI]
+		pos = Point2D(rng.getRand(bl.x, bounds.getWidth()),
+					  rng.getRand(bl.y, bounds.getHeight()));
+		ang = rng.getRand(-M_PI, 2.0 * M_PI);		// [-PI, PI]
 	}
 
 	// returns the distance of this particle to the point
-	forceinline float getDistanceTo(const Point2D &point) const {
+	forceinline F getDistanceTo(const Point2D_Wide<F> &point) const {
 		return pos.getDistanceTo(point);
 	}
 
 	// returns the bearing of this particle to the point
-	forceinline AngRad getBearingTo(const Point2D &point) const {
-		float dx = point.x - pos.x;
-		float dy = point.y - pos.y;
+	forceinline F getBearingTo(const Point2D_Wide<F> &point) const {
+		F dx = point.x - pos.x;
+		F dy = point.y - pos.y;
 
-		AngRad theta = atan2f(dy, dx);
+		F theta = L::atan2(dy, dx);
 		return normalizeAngleRD(theta - ang);
 	}
 };
 
+
+typedef Particle_Wide<float> Particle;
+
 // end of Particle.h
@@ -1,8 +1,11 @@
 // program entry point
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "sse/sse.h"
+#include "sys/PerfCounters.h"
 
 #include "pf.h"
 #include "Comparison.h"
@@ -15,27 +18,91 @@ static const char *OBS_FILENAME = "sim_obs.csv";
 int main(int argc, char **argv) {
 	SSE::init();
 
-	seedParticleGen(1);		// use a fixed random seed under normal runs
+	// hardware counters are optional, the filter runs the same without them
+	int numCounters = initPerfCounters();
+	printf("%d of %d performance counters available\n", numCounters, (int)NUM_PERF_COUNTERS);
 
-	initAllParticles();
+	// use a fixed random seed under normal runs
+	PfConfig config;
+	config.seed = 1;
 
-	loadObservationData(OBS_FILENAME);
+	// "-n <count>" sets the number of particles, "-t <count>" the number of
+	// threads, "-d" keeps the distance and bearing exponents apart for the
+	// displays of either alone, "-v" compares the bearings as unit vectors,
+	// "-k" resamples by KLD-sampling, "-f" estimates the pose in the same
+	// pass as the last observation, glut gets the rest of the arguments,
+	// under the program name
+	for (;;) {
+		if (argc >= 3 && strcmp(argv[1], "-n") == 0) {
+			config.numParticles = atoi(argv[2]);
+
+			argc -= 2;
+			argv += 2;
+			argv[0] = argv[-2];
+		} else if (argc >= 3 && strcmp(argv[1], "-t") == 0) {
+			config.numThreads = atoi(argv[2]);
+
+			argc -= 2;
+			argv += 2;
+			argv[0] = argv[-2];
+		} else if (argc >= 2 && strcmp(argv[1], "-d") == 0) {
+			config.splitExponents = true;
+
+			argc -= 1;
+			argv += 1;
+			argv[0] = argv[-1];
+		} else if (argc >= 2 && strcmp(argv[1], "-v") == 0) {
+			config.vectorBearings = true;
+
+			argc -= 1;
+			argv += 1;
+			argv[0] = argv[-1];
+		} else if (argc >= 2 && strcmp(argv[1], "-k") == 0) {
+			config.kldError = 0.05f;
+
+			argc -= 1;
+			argv += 1;
+			argv[0] = argv[-1];
+		} else if (argc >= 2 && strcmp(argv[1], "-f") == 0) {
+			config.fusedPose = true;
+
+			argc -= 1;
+			argv += 1;
+			argv[0] = argv[-1];
+		} else {
+			break;
+		}
+	}
+
+	ParticleFilter pf(config);
+
+	if (!pf.loadObservations(OBS_FILENAME)) {
+		return 1;
+	}
 
 #if 0
 	// test for accuracy in console mode
-	comparePfResults();
+	pf.compareModes();
 #elif 0
 	// compare SSE implementations of complex math functions
 	compareAbs();
+	compareTrunc();
+	compareFloor();
+	compareCeil();
+	compareRound();
+	compareFmod();
+	compareWrapAngle();
 	compareExp();
+	compareExpLut();
 	compareSin();
 	compareCos();
 	compareAtan();
+	compareAtanLut();
 	compareAtan2();
 //	compareOldAtan2();
 #else
 	// use the graphical viewer
-	initWindow(argc, argv);
+	initWindow(argc, argv, &pf);
 	enterDrawLoop();		// does not return
 #endif
 
@@ -1,21 +1,29 @@
-// particle filter, scalar and SSE versions
+// particle filter, written once over the lane types in Lanes.h
 
 #include <stdio.h>
 #include <math.h>
+#include <float.h>
 
 #include <iostream>
 #include <fstream>
+#include <string>
+#include <algorithm>
 using namespace std;
 
 #include "sys/common.h"
 #include "sys/mem.h"
+#include "sys/PerfCounters.h"
+#include "sys/Profiler.h"
 #include "sys/rand.h"
+#include "sys/TaskGraph.h"
+#include "sys/ThreadPool.h"
 #include "sys/Timer.h"
 
 #include "sse/sseMath.h"
+#include "sse/sseRand.h"
 
+#include "Lanes.h"
 #include "Particle.h"
-#include "Particle_4Wide.h"
 
 #include "pf.h"
 
@@ -24,9 +32,6 @@ using namespace std;
 
 static const float INV_M_PI = 1.0f / M_PI;
 
-static const int NUM_SCALAR_PARTICLES = 16384;
-static const int NUM_SSE_PARTICLES = NUM_SCALAR_PARTICLES / SSE_WIDTH;
-
 // coordinate system for the field
 //
 //                +---------+
@@ -63,571 +68,2254 @@ static const Point2D REF_OBJ_POS_ARR[] = {
 };
 static const int NUM_REF_OBJS = sizeof(REF_OBJ_POS_ARR) / sizeof(Point2D);
 
-// standard deviations for the observations (known from observation generator)
-static const float DIST_SIGMA = 0.2f;
-static const float BEAR_SIGMA = 0.05f;
-
-// precomputed versions of 1/(sigma*sigma),
-// used as coefficients when computing the exponents to the exponential function
-static const float DIST_EXP_COEFF = 1.0f / (DIST_SIGMA * DIST_SIGMA);
-static const float BEAR_EXP_COEFF = 1.0f / (BEAR_SIGMA * BEAR_SIGMA);
-
-static const float IDEAL_FPS = 30.0f;	// frames per second
-
-const char *PF_MODE_STRINGS[] = {
-	"scalar",
-	"sse"
-};
-
+// the particles in one chunk of work for the threads, a chunk's particles
+// and probability exponents (64 KB) fit in L2, must be a multiple of
+// TILE_PARTICLES
+static const int CHUNK_PARTICLES = 4096;
 
-//--- GLOBALS ---//
+// the particles in one tile of a chunk, a tile's particles and probability
+// exponents (4 KB) stay in L1 while every observation in the window is
+// applied to them, must be a multiple of the widest lane type
+static const int TILE_PARTICLES = 256;
 
-// the observations
-static Observation *obsData = NULL;		// observation data
-static ObservationWindow obsWindow;
+// the observations applied to each particle while its exponents are kept
+// in registers, the exponents are only stored once per block
+static const int OBS_BLOCK = 8;
 
-// the particles
-static Particle       scalarParticles[NUM_SCALAR_PARTICLES];
-static Particle_4Wide sseParticles   [NUM_SSE_PARTICLES];
+// the exponent of the particles left out of a frame by pruning, see
+// PfConfig::pruneExponent, the observations of later frames leave it far
+// below any other, so their weights stay negligible
+static const float PRUNED_EXPONENT = -1e30f;
 
-// probabilities calculated for each particle
-static ProbabilityExponents       scalarProb[NUM_SCALAR_PARTICLES];
-static ProbabilityExponents_4Wide sseProb   [NUM_SSE_PARTICLES];
+// the ranges of observations a frame can apply, see planFrame()
+static const int MAX_OBS_RANGES = 4;
 
-static PfMode pfMode = PF_SSE;		// default particle filter mode
-static float pfFps = 0.0f;			// last invocation's frames per second
+// the landmarks whose expected distances and bearings from each particle
+// of a tile are kept while the tile is weighed (12 KB at most), a frame
+// that sees more landmarks than this works them out for each observation
+static const int MAX_CACHED_LANDMARKS = 4;
 
+static const FieldMap DEFAULT_FIELD_MAP = FieldMap(FIELD, GRASS, REF_OBJ_POS_ARR, NUM_REF_OBJS);
 
-//--- BOUNDS CHECK ---//
-
-static
-void checkRefObjIdRange(int ref_obj_i) {
-	if (ref_obj_i < 0 || ref_obj_i >= NUM_REF_OBJS) {
-		printf("num reference objects: %d, bad index: %d\n",
-			   NUM_REF_OBJS, ref_obj_i);
-		exit(0);
-	}
-}
-
-
-//--- SETUP ---//
+const char *PF_MODE_STRINGS[] = {
+	"scalar",
+	"sse",
+	"sse8",
+	"sse16"
+};
 
-static
-void initScalarParticles() {
-	for (int i = 0; i < NUM_SCALAR_PARTICLES; i++){
-		scalarParticles[i].placeRandomly(GRASS);
-	}
-}
 
-// creates the sse particles from the scalar particles
-static
-void initSseParticles() {
-	for (int i = 0; i < NUM_SSE_PARTICLES; i++) {
-		int j = 4 * i;		// index into the non-sse array
+//--- PROFILING ---//
 
-		Particle &p0 = scalarParticles[j + 0];
-		Particle &p1 = scalarParticles[j + 1];
-		Particle &p2 = scalarParticles[j + 2];
-		Particle &p3 = scalarParticles[j + 3];
+// the profile zones and counter regions of one mode of one filter, named
+// after the mode, e.g. "sse frame", entered on the filter's thread alone
+class PfStages {
+private:
+	static const int NUM_NAMES = 10;
+	static const int NAME_LEN = 48;
 
-		sseParticles[i] = Particle_4Wide(p0, p1, p2, p3);
-	}
-}
+	char names[NUM_NAMES][NAME_LEN];		// must outlive the zones
 
-static
-void clearScalarProbabilities() {
-	for (int p = 0; p < NUM_SCALAR_PARTICLES; p++) {
-		scalarProb[p] = ProbabilityExponents(0.0f, 0.0f);
+	const char *makeName(int i, const char *mode, const char *stage) {
+		sprintf(names[i], "%.23s %.23s", mode, stage);
+		return names[i];
 	}
-}
 
-static
-void clearSseProbabilities() {
-	for (int p = 0; p < NUM_SSE_PARTICLES; p++) {
-		sseProb[p] = ProbabilityExponents_4Wide(sse4Floats::zeros(),
-												sse4Floats::zeros());
-	}
-}
+public:
+	ProfileZone frame;
+	ProfileZone observations;
+	ProfileZone mean;
+	ProfileZone stdDev;
+	ProfileZone frames;		// a batch of pipelined frames
+	ProfileZone fused;		// observations with the pose, see PfConfig::fusedPose
+	ProfileZone motion;
+	ProfileZone resample;
+
+	// hardware counters of the hot loops, counted per particle update when
+	// one thread runs the filter, see getCountedUpdates()
+	PerfRegion observationsRegion;
+	PerfRegion poseRegion;
+
+	PfStages(const char *mode)
+		: frame             (makeName(0, mode, "frame")),
+		  observations      (makeName(1, mode, "observations")),
+		  mean              (makeName(2, mode, "weighted mean")),
+		  stdDev            (makeName(3, mode, "weighted std dev")),
+		  frames            (makeName(4, mode, "pipelined frames")),
+		  fused             (makeName(5, mode, "fused")),
+		  motion            (makeName(6, mode, "motion")),
+		  resample          (makeName(7, mode, "resample")),
+		  observationsRegion(makeName(8, mode, "observations")),
+		  poseRegion        (makeName(9, mode, "estimate pose")) {}
+};
 
 
 //--- DISTANCE PROBABILITY ---//
 
 // Gets the exponent of the similarity measure based on seen and expected distances to
-// two objects.
-static forceinline
-float getDistanceSimExponent(float expectedDist, float observedDist, float coeffDist) {
-	// normalize by max(expected, observed) to account for the fact that greater
-	// deviation is expected when the distance is greater
-	float d = fabsf(expectedDist - observedDist) / max(expectedDist, observedDist);
-	assert(inbounds(d, 0.0f, 1.0f));
-	return -coeffDist * d * d;
-}
-
-// Gets the similarity measure based on seen and expected distances to
-// two objects.
+// two objects.  F is any lane type (see Lanes.h).
+template <class F>
 static forceinline
-float getDistanceSim(float expectedDist, float observedDist, float coeffDist) {
-	return exp(getDistanceSimExponent(expectedDist, observedDist, coeffDist));
-}
+F getDistanceSimExponent(F expectedDist, F observedDist, F coeffDist) {
+	typedef Lanes<F> L;
 
-// Gets the exponent of the similarity measure based on seen and expected distances to
-// two objects.
-static forceinline
-sse4Floats getDistanceSimExponent(sse4Floats expectedDist,
-								  sse4Floats observedDist,
-								  sse4Floats coeffDist)
-{
 	// normalize by max(expected, observed) to account for the fact that greater
 	// deviation is expected when the distance is greater
-	sse4Floats d = abs(expectedDist - observedDist) / max4(expectedDist, observedDist);
-	assert(inbounds(d, 0.0f, 1.0f));
+	F d = L::abs(expectedDist - observedDist) / L::max(expectedDist, observedDist);
+	assert(L::inbounds(d, 0.0f, 1.0f));
 	return -coeffDist * d * d;
 }
 
-// Gets the exponent of the similarity measure based on seen and expected distances to
+// Gets the similarity measure based on seen and expected distances to
 // two objects.
+template <class F>
 static forceinline
-sse4Floats getDistanceSim(sse4Floats expectedDist,
-						  sse4Floats observedDist,
-						  sse4Floats coeffDist)
-{
-	return exp(getDistanceSimExponent(expectedDist, observedDist, coeffDist));
+F getDistanceSim(F expectedDist, F observedDist, F coeffDist) {
+	return Lanes<F>::exp(getDistanceSimExponent(expectedDist, observedDist, coeffDist));
 }
 
 
 //--- BEARING PROBABILITY ---//
 
 // Gets the exponent of the similarity measure based on seen and expected angles of
-// the landmarks.
+// the landmarks.  F is any lane type (see Lanes.h).
+template <class F>
 static forceinline
-float getBearingSimExponent(AngRad expectedAng,
-							AngRad observedAng,
-							float coeffAng)
-{
+F getBearingSimExponent(F expectedAng, F observedAng, F coeffAng) {
+	typedef Lanes<F> L;
+
 	// normalize by PI since the absolue min angle diff is on [0, PI]
-	float d = absMinAngleDiff(expectedAng, observedAng) * INV_M_PI;
-	assert(inbounds(d, 0.0f, 1.0f));
+	F d = absMinAngleDiff(expectedAng, observedAng) * L::expand(INV_M_PI);
+	assert(L::inbounds(d, 0.0f, 1.0f));
 	return -coeffAng * d * d;
 }
 
-// Gets the similarity measure based on seen and expected angles of
-// the landmarks.
+// Gets the exponent of the similarity measure from the cosine of the
+// angle between the seen and expected bearings, without atan2, since
+// 2*(1 - cos(a)) is a*a for small angles.
+template <class F>
 static forceinline
-float getBearingSim(AngRad expectedAng,
-					AngRad observedAng,
-					float coeffAng)
-{
-	return exp(getBearingSimExponent(expectedAng, observedAng, coeffAng));
-}
+F getBearingCosSimExponent(F cosDiff, F coeffAng) {
+	typedef Lanes<F> L;
 
-// Gets the exponent of the similarity measure based on seen and expected angles of
-// the landmarks.
-static forceinline
-sse4Floats getBearingSimExponent(AngRad4 expectedAng,
-								 AngRad4 observedAng,
-								 AngRad4 coeffAng)
-{
-	// normalize by PI since the absolue min angle diff is on [0, PI]
-	AngRad4 d = absMinAngleDiff(expectedAng, observedAng)
-				* sse4Floats::expand(INV_M_PI);
-	assert(inbounds(d, 0.0f, 1.0f));
-	return -coeffAng * d * d;
+	// rounding can take the cosine of a unit vector's angle past 1
+	F d2 = L::max(L::expand(1.0f) - cosDiff, L::zeros()) * L::expand(2.0f * INV_M_PI * INV_M_PI);
+	assert(L::inbounds(d2, 0.0f, 1.0f));
+	return -coeffAng * d2;
 }
 
 // Gets the similarity measure based on seen and expected angles of
 // the landmarks.
+template <class F>
 static forceinline
-sse4Floats getBearingSim(AngRad4 expectedAng,
-						 AngRad4 observedAng,
-						 AngRad4 coeffAng)
-{
-	return exp(getBearingSimExponent(expectedAng, observedAng, coeffAng));
+F getBearingSim(F expectedAng, F observedAng, F coeffAng) {
+	return Lanes<F>::exp(getBearingSimExponent(expectedAng, observedAng, coeffAng));
 }
 
 
-//--- POSE ESTIMATION ---//
+//--- POSE STATISTICS ---//
 
-// Computes the weighted mean of the robot pose (location and bearing) and
-// the weighted standard deviation of the robot pose.  This
-// version computes the values using a standard two-pass algorithm
-// which computes the mean in the first pass and the standard deviation
-// in the second pass.
-//
-// Only scalar operations are used.
-static noinline
-RobotPose scalarEstimatePose() {
-	Point2D  pos_accum = Point2D(0.0f, 0.0f);
-	Vector2D ori_accum = Vector2D(0.0f, 0.0f);
-	float    w_accum   = 0.0f;		// weight accumulator
+// the total weight, weighted mean, and sum of weighted squared deviations
+// of a set of positions, by West's incremental algorithm
+class WeightedStats {
+public:
+	float   w;
+	Point2D mean;
+	Point2D m2;
+
+	forceinline WeightedStats()
+		: w(0.0f), mean(0.0f, 0.0f), m2(0.0f, 0.0f) {}
 
-	// compute weighted mean
-	for (int i = 0; i < NUM_SCALAR_PARTICLES; i++) {
-		Point2D &pos = scalarParticles[i].pos;
-		AngRad  &ang = scalarParticles[i].ang;
-		float    w   = expf(getDistancePlusBearingExponent(scalarProb[i]));
+	forceinline WeightedStats(float in_w, Point2D in_mean, Point2D in_m2)
+		: w(in_w), mean(in_mean), m2(in_m2) {}
+
+	// adds the positions of rhs (Chan et al.), the result depends on the
+	// order of the merges, so merge in a fixed order
+	void merge(const WeightedStats &rhs) {
+		float total = w + rhs.w;
+		if (total == 0.0f) {
+			return;
+		}
 
-		pos_accum += pos * w;
-		ori_accum += Point2D::fromPolar(w, ang);
-		w_accum   += w;
+		Point2D d = rhs.mean - mean;
+		mean = mean + d * (rhs.w / total);
+		m2 = m2 + rhs.m2 + d * d * (w * rhs.w / total);
+		w = total;
 	}
-	assert(w_accum != 0.0f);
-	assert(ori_accum.getMagnitude() != 0.0f);
 
-	float inv_total_w = 1.0f / w_accum;
+	Point2D getVariance() const {
+		return m2 * (1.0f / w);
+	}
 
-	Point2D pos_mn = pos_accum * inv_total_w;
-	AngRad  ang_mn = ori_accum.getDirection();
+	// the same positions with every weight times s
+	WeightedStats scaled(float s) const {
+		return WeightedStats(w * s, mean, m2 * s);
+	}
+};
 
-	Point2D pd2_accum = Point2D(0.0f, 0.0f);
-	AngRad  ad2_accum = 0.0f;
 
-	// compute weighted standard deviation
-	for (int i = 0; i < NUM_SCALAR_PARTICLES; i++) {
-		Point2D &pos = scalarParticles[i].pos;
-		AngRad  &ang = scalarParticles[i].ang;
-		float    w   = expf(getDistancePlusBearingExponent(scalarProb[i]));
+//--- MOTION ---//
 
-		Point2D pd = pos - pos_mn;
-		pd2_accum += pd * pd * w;
+// any angle on [-PI, PI], wrapped as the particles' angles are
+static
+float wrapAngle(float ang) {
+	return _mm_cvtss_f32(normalizeAngle(AngRad4::expand(ang)).data);
+}
 
-		AngRad  ad = absMinAngleDiff(ang, ang_mn);
-		ad2_accum += ad * ad * w;
-	}
+// a seed for each of several generators from one seed, the 32-bit
+// finalizer of MurmurHash3 spreads consecutive b across all the bits
+static
+unsigned int mixSeed(unsigned int a, unsigned int b) {
+	unsigned int h = (a * 0x9e3779b9u) ^ b;
+	h ^= h >> 16;
+	h *= 0x85ebca6bu;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+	return h;
+}
 
-	Point2D pos_var = pd2_accum * inv_total_w;
-	AngRad  ang_var = ad2_accum * inv_total_w;
+// the bits set in v
+static
+int countBits(unsigned int v) {
+	int n = 0;
+	for (; v != 0; v &= v - 1) {
+		n++;
+	}
+	return n;
+}
 
-	Point2D pos_sd = sqrt(pos_var);
-	AngRad  ang_sd = sqrt(ang_var);
+// the particles KLD-sampling draws from k bins (Fox, 2003), by the
+// Wilson-Hilferty approximation of the chi-square quantile
+static
+int getKldParticles(int k, float error, float quantile) {
+	if (k <= 1) {
+		return 1;
+	}
 
-	return RobotPose(pos_mn, ang_mn, pos_sd, ang_sd);
+	double a = 2.0 / (9.0 * (k - 1));
+	double b = 1.0 - a + sqrt(a) * quantile;
+	double n = (k - 1) / (2.0 * error) * b * b * b;
+	return (int)min(ceil(n), (double)MAX_NUM_PARTICLES);
 }
 
-// Computes the weighted mean of the robot pose (location and bearing) and
-// the weighted standard deviation of the robot pose.  This
-// version computes the values using a standard two-pass algorithm
-// which computes the mean in the first pass and the standard deviation
-// in the second pass.
-//
-// SSE operations are used whenever possible.
-static noinline
-RobotPose sseEstimatePose() {
-	Point2D_4Wide  pos_accum4 = Point2D_4Wide (sse4Floats::zeros(),
-											   sse4Floats::zeros());
-	Vector2D_4Wide ori_accum4 = Vector2D_4Wide(sse4Floats::zeros(),
-											   sse4Floats::zeros());
-	sse4Floats       w_accum4 = sse4Floats::zeros();
 
-	// compute weighted mean
-	for (int i = 0; i < NUM_SSE_PARTICLES; i++) {
-		Point2D_4Wide &pos4 = sseParticles[i].pos;
-		AngRad4       &ang4 = sseParticles[i].ang;
-		sse4Floats     w4   = exp(getDistancePlusBearingExponent(sseProb[i]));
+//--- PARTICLE FILTER ---//
+
+// the particles of one mode of a ParticleFilter and the filter that
+// runs on them, the modes differ only in their lane type
+class PfKernel {
+public:
+	virtual ~PfKernel() {}
+
+	// copies in n starting particles, replacing any that are loaded
+	virtual void init(const Particle *in, int n) = 0;
+
+	// frees the particles, getNumParticles() is 0 until the next init()
+	virtual void release() = 0;
+
+	virtual int getNumParticles() const = 0;
+
+	// weighs the particles against the observation window and
+	// returns the estimated pose
+	virtual RobotPose run() = 0;
+
+	// run() for each window, with the frames overlapping
+	virtual void runFrames(const ObservationWindow *windows, RobotPose *poses, int numFrames) = 0;
+
+	// forgets the exponents of the last frames, carried ones too, so the
+	// next frame weighs the particles against its whole window
+	virtual void invalidate() = 0;
 
-		pos_accum4 += pos4 * w4;
-		ori_accum4 += Vector2D_4Wide_Polar(w4, ang4);
-		w_accum4   += w4;
+	// moves the particles by the odometry, the noise is drawn from seed
+	virtual void predict(const Odometry &u, unsigned int seed) = 0;
+
+	// draws new particles in proportion to the weights of the last frame,
+	// as many as before or as KLD-sampling needs, the draws come from seed,
+	// returns false and leaves the particles if they all weigh nothing
+	virtual bool resample(ResampleMethod method, unsigned int seed) = 0;
+
+	// the effective sample size of the last frame, see ParticleFilter, -1
+	// if the particles have moved or been drawn since
+	virtual float getEffectiveSampleSize() const = 0;
+
+	virtual Particle getParticle(int index) const = 0;
+
+	virtual ProbabilityExponents getProbabilityExponents(int index) const = 0;
+};
+
+// the particle filter for lane type F, which weighs Lanes<F>::WIDTH
+// particles per step, in chunks of CHUNK_PARTICLES on the thread pool,
+// see "How the filter runs" in README.txt
+template <class F>
+class PfKernel_Wide : public PfKernel {
+private:
+	typedef Lanes<F> L;
+
+	static const int CHUNK_WIDES = CHUNK_PARTICLES / L::WIDTH;
+	static const int TILE_WIDES = TILE_PARTICLES / L::WIDTH;
+	static const int NUM_SLOTS = 2;
+
+	// the weighted sums of one chunk
+	struct ChunkSums {
+		Point2D  pos;		// positions
+		Vector2D ori;		// unit vectors of the angles
+		float    w;			// weights
+		float    w2;		// squared weights, for the effective sample size
+
+		Point2D  pd2;		// squared deviations from the mean position
+		AngRad   ad2;		// squared deviations from the mean angle
+
+		WeightedStats stats;	// fused, the positions, with ori for the angles
+
+		float maxExp;		// the largest exponent, the sums are of the weights over its
+	};
+
+	// observations [begin, end), taken out of the exponents if remove
+	struct ObsRange {
+		int begin;
+		int end;
+		bool remove;
+	};
+
+	// an observation expanded to the lanes
+	struct ObservationWide {
+		F distance;
+		F bearing;
+		Point2D_Wide<F> bearingDir;		// the unit vector of the bearing
+		Point2D_Wide<F> refObjPos;
+
+		F distExpCoeff;		// 1/(sigma*sigma), the coefficients of the exponents
+		F bearExpCoeff;
+
+		int cached;			// the frame's cache index of the landmark
+	};
+
+	// one frame, from the observation window to the pose
+	struct Frame {
+		PfKernel_Wide *kernel;
+		ObservationWindow window;
+
+		F *logWeights;		// the frame's slot
+		F *distanceExps;	// NULL unless the slot keeps them, see allocSlot()
+		ChunkSums *sums;
+
+		// the observations to apply to the slot's exponents, see planFrame()
+		ObsRange ranges[MAX_OBS_RANGES];
+		int numRanges;
+		int numTerms;		// the observations in all the ranges
+		bool clear;			// start from zero rather than the slot's exponents
+
+		// the landmarks seen by more than one of the observations, or 0 if
+		// none are, then each observation works out its own expectations
+		int cachedIds[MAX_CACHED_LANDMARKS];
+		int numCached;
+
+		Point2D pos_mn;		// mean pose, for the std dev chunks
+		AngRad  ang_mn;
+		float   inv_total_w;
+		float   maxExp;		// the largest exponent, see getWeight()
+
+		RobotPose pose;
+		float ess;			// the effective sample size
+	};
+
+	// one motion update, the standard deviations of the noise are the
+	// same for every particle
+	struct Motion {
+		PfKernel_Wide *kernel;
+		Odometry u;
+		float sdRot1;
+		float sdTrans;
+		float sdRot2;
+		unsigned int seed;
+	};
+
+	// where the draws of one chunk of particles start, in draws, the
+	// weight before the chunk less the offset is base + frac
+	struct ChunkDraws {
+		float  total;		// the weight of the chunk
+		double start;		// the weight of the chunks before it
+		int    base;
+		float  frac;		// on [0, 1)
+		int    first;		// the first draw of its particles
+	};
+
+	// one resampling, the new particle j is drawn at (j + offset)*step
+	// into the total weight, where offset is on [0, 1)
+	struct Resampling {
+		PfKernel_Wide *kernel;
+		const F *logWeights;	// the weights to draw by
+		Particle_Wide<F> *out;	// numDraws particles in whole wides
+		ChunkDraws *chunks;		// numChunks + 1, the last is the end
+
+		int numDraws;		// the particles of the new set
+		double step;		// the total weight over numDraws
+		float invStep;
+		float offset;		// systematic, the offset of every draw
+		bool stratified;	// each draw has an offset of its own, see getOffset()
+		unsigned int seed;
+
+		// KLD, a bit for each bin of poses that a particle drawn is in, a
+		// set of binWords for each chunk, or NULL
+		unsigned int *bins;
+		int binWords;
+		Point2D binOrigin;
+		float invBinSize;
+		float invBinAngle;
+		int binsX;
+		int binsY;
+		int binsA;
+	};
+
+	// instance variables
+	Particle_Wide<F>             *particles;			// 16-byte aligned
+	Particle_Wide<F>             *spare;				// resample() draws into these
+
+	// for resample(), each chunk starts on a whole wide
+	float *cdf;				// by particle, the running sums of the weights
+	int   *marks;			// by draw, the particle drawn first at it, or -1
+	int    numMarks;		// the draws marks has room for, with the spares
+	F         *logWeights[NUM_SLOTS];	// for each particle, the sum of its exponents
+	F         *distanceExps[NUM_SLOTS];	// and its distance exponent, if split
+	ChunkSums *sums[NUM_SLOTS];			// for each chunk
+	int shownSlot;			// the slot of the last frame
+	float ess;				// of the last frame, -1 if the particles changed since
+	float maxExp;			// of the last frame, its weights are over the weight of it
+
+	ObservationWindow slotWindows[NUM_SLOTS];	// the last window weighed in each slot
+	int slotAges[NUM_SLOTS];	// frames since it was weighed in full, -1 if never
+	int carriedEnd;			// the observations before it are carried in slot 0, -1 if none are
+
+	int numParticles;
+	int numWides;			// numParticles rounded up to whole wides
+	int numChunks;
+	int tailWide;			// the partly filled last wide, or -1 if there is none
+	int tailCount;			// the number of particles in tailWide
+
+	const ParticleFilter &pf;		// the observations, map, settings and threads
+	PfStages stages;
+
+	// not copyable, owns the particles
+	PfKernel_Wide(const PfKernel_Wide &rhs);
+	PfKernel_Wide &operator =(const PfKernel_Wide &rhs);
+
+	// the weights of the particles in wide i over the weight of maxExp,
+	// lanes past the last particle weigh nothing
+	forceinline F getWeight(const F *logw, int i, const F &maxExp) const {
+		F w = L::exp(logw[i] - maxExp);
+		return (i == tailWide) ? L::blend(L::firstLanes(tailCount), w, L::zeros()) : w;
 	}
-	Point2D  pos_accum = pos_accum4.reduce_add();
-	Vector2D ori_accum = ori_accum4.reduce_add();
-	float      w_accum = w_accum4.reduce_add();
-	assert(w_accum != 0.0f);
-	assert(ori_accum.getMagnitude() != 0.0f);
 
-	float inv_total_w = 1.0f / w_accum;
+	// the largest exponent of the wides [begin, end) in each lane, from
+	// at least floor
+	forceinline F getMaxExponent(const F *logw, int begin, int end, F floor) const {
+		for (int i = begin; i < end; i++) {
+			floor = L::max(floor, logw[i]);
+		}
+		return floor;
+	}
 
-	Point2D pos_mn = pos_accum * inv_total_w;
-	AngRad  ang_mn = ori_accum.getDirection();
+	// (sum w)^2 / sum w^2 from the sums of the weights and their squares,
+	// rounding can take it a little past the number of particles
+	float getEss(float w, float w2) const {
+		if (w2 <= 0.0f) {
+			return 0.0f;
+		}
+		return min((float)((double)w * w / w2), (float)numParticles);
+	}
+
+	// the counts for n particles, nothing is allocated
+	void setNumParticles(int n) {
+		numParticles = n;
+		numWides = (n + L::WIDTH - 1) / L::WIDTH;
+		numChunks = (numWides + CHUNK_WIDES - 1) / CHUNK_WIDES;
+
+		tailCount = n - (numWides - 1) * L::WIDTH;
+		tailWide = (tailCount < L::WIDTH) ? numWides - 1 : -1;
+	}
 
-	Point2D_4Wide pos_mn4 = Point2D_4Wide::expand(pos_mn);
-	AngRad4       ang_mn4 = AngRad4::expand(ang_mn);
+	// the wides [begin, end) of chunk c
+	forceinline void getChunk(int c, int &begin, int &end) const {
+		begin = c * CHUNK_WIDES;
+		end = min(begin + CHUNK_WIDES, numWides);
+	}
 
-	Point2D_4Wide pd2_accum4 = Point2D_4Wide(sse4Floats::zeros(),
-											 sse4Floats::zeros());
-	AngRad4       ad2_accum4 = AngRad4::zeros();
+	// allocates the exponents and sums of a slot, the distance exponents
+	// only with PfConfig::splitExponents
+	void allocSlot(int slot) {
+		if (logWeights[slot] != NULL) {
+			return;
+		}
 
-	// compute weighted standard deviation
-	for (int i = 0; i < NUM_SSE_PARTICLES; i++) {
-		Point2D_4Wide &pos4 = sseParticles[i].pos;
-		AngRad4       &ang4 = sseParticles[i].ang;
-		sse4Floats     w4   = exp(getDistancePlusBearingExponent(sseProb[i]));
+		logWeights[slot] = (F *)malloc16(sizeof(F) * numWides);
+		sums[slot] = (ChunkSums *)malloc16(sizeof(ChunkSums) * numChunks);
+		dieIf(logWeights[slot] == NULL || sums[slot] == NULL, "could not allocate the particles");
 
-		Point2D_4Wide pd4 = pos4 - pos_mn4;
-		pd2_accum4       += pd4 * pd4 * w4;
+		if (pf.getConfig().splitExponents) {
+			distanceExps[slot] = (F *)malloc16(sizeof(F) * numWides);
+			dieIf(distanceExps[slot] == NULL, "could not allocate the particles");
+		}
 
-		AngRad4       ad4 = absMinAngleDiff(ang4, ang_mn4);
-		ad2_accum4       += ad4 * ad4 * w4;
+		clearSlot(slot);
+		slotAges[slot] = -1;
 	}
-	Point2D pd2_accum = pd2_accum4.reduce_add();
-	AngRad  ad2_accum = ad2_accum4.reduce_add();
 
-	Point2D pos_var = pd2_accum * inv_total_w;
-	AngRad  ang_var = ad2_accum * inv_total_w;
+	// sets the exponents of a slot to 0
+	void clearSlot(int slot) {
+		F *logw = logWeights[slot];
+		F *dist = distanceExps[slot];
 
-	Point2D pos_sd = sqrt(pos_var);
-	AngRad  ang_sd = sqrt(ang_var);
+		for (int i = 0; i < numWides; i++) {
+			logw[i] = L::zeros();
+		}
 
-	return RobotPose(pos_mn, ang_mn, pos_sd, ang_sd);
-}
+		if (dist != NULL) {
+			for (int i = 0; i < numWides; i++) {
+				dist[i] = L::zeros();
+			}
+		}
+	}
 
+	// allocates the buffers of resample() for numDraws draws, with a spare
+	// mark for each chunk, see markChunk()
+	void allocResampling(int numDraws) {
+		if (spare == NULL) {
+			spare = (Particle_Wide<F> *)malloc16(sizeof(Particle_Wide<F>) * numWides);
+			cdf = (float *)malloc16(sizeof(float) * numChunks * CHUNK_PARTICLES);
+			dieIf(spare == NULL || cdf == NULL, "could not allocate the particles");
+		}
 
-//--- PARTICLE FILTER ---//
-
-// scalar version of the particle filter
-static noinline
-RobotPose scalarPf() {
-	clearScalarProbabilities();
+		if (numDraws + numChunks > numMarks) {
+			free16(marks);
+			numMarks = numDraws + numChunks;
+			marks = (int *)malloc16(sizeof(int) * numMarks);
+			dieIf(marks == NULL, "could not allocate the particles");
+		}
+	}
 
-	int ob = obsWindow.getBase();
-	int on = obsWindow.getSize();
+	// the next frame in the slot, frames must be made in the order they run
+	Frame makeFrame(int slot, const ObservationWindow &window) {
+		Frame f;
+		f.kernel = this;
+		f.window = window;
+		f.logWeights = logWeights[slot];
+		f.distanceExps = distanceExps[slot];
+		f.sums = sums[slot];
+		planFrame(f, slot);
+		return f;
+	}
 
-	for (int oi = 0; oi < on ; oi++) {
-		Observation &obs = obsData[ob + oi];
-
-		// the observed distance and bearing to the landmark
-		float observedDistance = obs.d;
-		AngRad observedBearing = obs.b;
+	static void addRange(Frame &f, int begin, int end, bool remove) {
+		if (begin < end) {
+			assert(f.numRanges < MAX_OBS_RANGES);
 
-		// location of the reference object
-		Point2D refObjPos = REF_OBJ_POS_ARR[obs.id];
+			ObsRange &r = f.ranges[f.numRanges++];
+			r.begin = begin;
+			r.end = end;
+			r.remove = remove;
+			f.numTerms += end - begin;
+		}
+	}
 
-		for (int p = 0; p < NUM_SCALAR_PARTICLES; p++) {
-			Particle &part = scalarParticles[p];
+	// chooses the observations frame f applies to its slot's exponents, the
+	// whole window, or what changed since the slot's last one, or what is
+	// past the carried ones
+	void planFrame(Frame &f, int slot) {
+		int nb = f.window.getBase();
+		int ne = nb + f.window.getSize();
+		int ob = slotWindows[slot].getBase();
+		int oe = ob + slotWindows[slot].getSize();
+
+		int age = slotAges[slot];
+		int overlap = max(0, min(oe, ne) - max(ob, nb));
+		int changed = (oe - ob) + (ne - nb) - 2 * overlap;
+
+		f.numRanges = 0;
+		f.numTerms = 0;
+
+		if (carriedEnd >= 0) {
+			assert(slot == 0);
+			f.clear = false;
+			addRange(f, max(carriedEnd, nb), ne, false);
+			carriedEnd = max(carriedEnd, ne);
+		} else if (age < 0 || age >= pf.getConfig().recomputeFrames ||
+			overlap == 0 || changed >= ne - nb) {
+			f.clear = true;
+			addRange(f, nb, ne, false);
+			slotAges[slot] = 0;
+		} else {
+			f.clear = false;
+			addRange(f, ob, min(oe, nb), true);
+			addRange(f, max(ob, ne), oe, true);
+			addRange(f, nb, min(ne, ob), false);
+			addRange(f, max(nb, oe), ne, false);
+			slotAges[slot] = age + 1;
+		}
+		slotWindows[slot] = f.window;
 
-			// if we were at the current particle, this is the expected
-			// distance and expected bearing to the landmark's known location
-			float expectedDistance = part.getDistanceTo(refObjPos);
-			AngRad expectedBearing = part.getBearingTo(refObjPos);
+		planCache(f);
+	}
 
-			float distanceExp = getDistanceSimExponent(expectedDistance,
-													   observedDistance,
-													   DIST_EXP_COEFF);
+	// caches the landmarks of the frame if some observations share one,
+	// and they all fit
+	void planCache(Frame &f) const {
+		const Observation *obs = pf.getObservations();
+		f.numCached = 0;
+
+		for (int r = 0; r < f.numRanges; r++) {
+			for (int i = f.ranges[r].begin; i < f.ranges[r].end; i++) {
+				if (findCached(f, obs[i].id) >= 0) {
+					continue;
+				}
+
+				if (f.numCached == MAX_CACHED_LANDMARKS) {
+					f.numCached = 0;
+					return;
+				}
+				f.cachedIds[f.numCached++] = obs[i].id;
+			}
+		}
 
-			float bearingExp = getBearingSimExponent(expectedBearing,
-													 observedBearing,
-													 BEAR_EXP_COEFF);
+		if (f.numCached == f.numTerms) {
+			f.numCached = 0;
+		}
+	}
 
-			scalarProb[p] += ProbabilityExponents(distanceExp, bearingExp);
+	// the cache index of landmark id, or -1 if it is not cached
+	static int findCached(const Frame &f, int id) {
+		for (int l = 0; l < f.numCached; l++) {
+			if (f.cachedIds[l] == id) {
+				return l;
+			}
 		}
+		return -1;
 	}
-
-	return scalarEstimatePose();
-}
-
-// SSE version of the particle filter
-static noinline
-RobotPose ssePf() {
-	clearSseProbabilities();
 
-	sse4Floats distExpCoeff = sse4Floats::expand(DIST_EXP_COEFF);
-	sse4Floats bearExpCoeff = sse4Floats::expand(BEAR_EXP_COEFF);
-
-	int ob = obsWindow.getBase();
-	int on = obsWindow.getSize();
+	// observation i, with its exponents negated if remove, which takes it
+	// back out of a sum exactly since -c*d*d is the negation of c*d*d
+	ObservationWide getObservation(const Frame &f, int i, bool remove) const {
+		const PfConfig &config = pf.getConfig();
+		const Observation &obs = pf.getObservations()[i];
 
-	for (int oi = 0; oi < on; oi++) {
-		Observation &obs = obsData[ob + oi];
+		ObservationWide o;
 
 		// the observed distance and bearing to the landmark
-		sse4Floats observedDistance = sse4Floats::expand(obs.d);
-		AngRad4    observedBearing  = AngRad4::expand(obs.b);
+		o.distance = L::expand(obs.d);
+		o.bearing  = L::expand(obs.b);
 
-		// location of the reference object
-		Point2D_4Wide refObjPos = Point2D_4Wide::expand(REF_OBJ_POS_ARR[obs.id]);
+		o.bearingDir = Point2D_Wide<F>::expand(Point2D::fromPolar(1.0f, obs.b));
 
-		for (int p = 0; p < NUM_SSE_PARTICLES; p++) {
-			Particle_4Wide &part = sseParticles[p];
+		// location of the reference object
+		o.refObjPos = Point2D_Wide<F>::expand(pf.getMap().refObjs[obs.id]);
 
-			// if we were at the current particle, this is the expected
-			// distance and expected bearing to the landmark's known location
-			sse4Floats expectedDistance = part.getDistanceTo(refObjPos);
-			AngRad4    expectedBearing  = part.getBearingTo(refObjPos);
+		float sign = remove ? -1.0f : 1.0f;
+		o.distExpCoeff = L::expand(sign / (config.distSigma * config.distSigma));
+		o.bearExpCoeff = L::expand(sign / (config.bearSigma * config.bearSigma));
 
-			sse4Floats distanceExp = getDistanceSimExponent(expectedDistance,
-															observedDistance,
-															distExpCoeff);
+		o.cached = findCached(f, obs.id);
+		return o;
+	}
+
+	// observation t of the frame's ranges
+	ObservationWide getTerm(const Frame &f, int t) const {
+		int i = 0;
+		while (t >= f.ranges[i].end - f.ranges[i].begin) {
+			t -= f.ranges[i].end - f.ranges[i].begin;
+			i++;
+			assert(i < f.numRanges);
+		}
+
+		return getObservation(f, f.ranges[i].begin + t, f.ranges[i].remove);
+	}
+
+	// the sensor models, see PfConfig::vectorBearings, each works out the
+	// distance and bearing to a landmark expected from a wide of particles,
+	// and weighs an observation of the landmark against them
+
+	// the bearing as an angle, from atan2
+	struct AngleSensor {
+		typedef Particle_Wide<F> Pose;
+
+		struct Expected {
+			F distance;
+			F bearing;
+		};
+
+		static forceinline Pose prepare(const Particle_Wide<F> &part) {
+			return part;
+		}
+
+		// if we were at the particles, these are the expected distance and
+		// expected bearing to the landmark's known location
+		static forceinline Expected expect(const Pose &part, const Point2D_Wide<F> &refObjPos) {
+			Expected e;
+			e.distance = part.getDistanceTo(refObjPos);
+			e.bearing  = part.getBearingTo(refObjPos);
+			return e;
+		}
+
+		// the exponents of the similarity of the particles to an observation
+		static forceinline
+		ProbabilityExponents_Wide<F> weigh(const Expected &e, const ObservationWide &o) {
+			F distanceExp = getDistanceSimExponent(e.distance,
+												   o.distance,
+												   o.distExpCoeff);
+
+			F bearingExp = getBearingSimExponent(e.bearing,
+												 o.bearing,
+												 o.bearExpCoeff);
+
+			return ProbabilityExponents_Wide<F>(distanceExp, bearingExp);
+		}
+	};
+
+	// the bearing as a unit vector in the particle's frame, from the
+	// direction to the landmark and the heading of the particle, which is
+	// compared with the observed bearing by their dot product
+	struct VectorSensor {
+		struct Pose {
+			Point2D_Wide<F> pos;
+			Point2D_Wide<F> heading;	// the unit vector of the angle
+		};
+
+		struct Expected {
+			F distance;
+			Point2D_Wide<F> bearing;
+		};
+
+		static forceinline Pose prepare(const Particle_Wide<F> &part) {
+			Pose pose;
+			pose.pos = part.pos;
+			pose.heading = Point2D_Wide<F>::fromPolar(L::expand(1.0f), part.ang);
+			return pose;
+		}
+
+		static forceinline Expected expect(const Pose &pose, const Point2D_Wide<F> &refObjPos) {
+			Point2D_Wide<F> d = refObjPos - pose.pos;
+			const Point2D_Wide<F> &h = pose.heading;
+
+			Expected e;
+			e.distance = d.getMagnitude();
+
+			// the direction to the landmark, turned by minus the heading
+			F inv_d = L::expand(1.0f) / e.distance;
+			e.bearing = Point2D_Wide<F>(d.x * h.x + d.y * h.y,
+										d.y * h.x - d.x * h.y) * inv_d;
+			return e;
+		}
+
+		static forceinline
+		ProbabilityExponents_Wide<F> weigh(const Expected &e, const ObservationWide &o) {
+			F distanceExp = getDistanceSimExponent(e.distance,
+												   o.distance,
+												   o.distExpCoeff);
 
-			sse4Floats bearingExp = getBearingSimExponent(expectedBearing,
-														  observedBearing,
-														  bearExpCoeff);
+			F cosDiff = e.bearing.x * o.bearingDir.x + e.bearing.y * o.bearingDir.y;
+			F bearingExp = getBearingCosSimExponent(cosDiff, o.bearExpCoeff);
 
-			sseProb[p] += ProbabilityExponents_4Wide(distanceExp, bearingExp);
+			return ProbabilityExponents_Wide<F>(distanceExp, bearingExp);
 		}
+	};
+
+	// the exponents of wide p, lanes past the last particle are -FLT_MAX
+	forceinline F getLaneExponents(const F *logw, int p) const {
+		return (p == tailWide) ? L::blend(L::firstLanes(tailCount), logw[p], L::expand(-FLT_MAX)) : logw[p];
 	}
 
-	return sseEstimatePose();
-}
+	// the sums of the exponents of the bn observations of block for wide
+	// p, from the expectations of the frame's cached landmarks if e is
+	// not NULL
+	template <class S>
+	forceinline
+	ProbabilityExponents_Wide<F> weighBlock(int p, const ObservationWide *block, int bn,
+											const typename S::Expected *e) const
+	{
+		ProbabilityExponents_Wide<F> acc(L::zeros(), L::zeros());
+
+		if (e != NULL) {
+			for (int k = 0; k < bn; k++) {
+				acc += S::weigh(e[block[k].cached], block[k]);
+			}
+		} else {
+			typename S::Pose pose = S::prepare(particles[p]);
+			for (int k = 0; k < bn; k++) {
+				acc += S::weigh(S::expect(pose, block[k].refObjPos), block[k]);
+			}
+		}
+		return acc;
+	}
+
+	// applies the observations of the frame to the exponents of the wides
+	// [tile, tileEnd) with sensor model S, after the first block a wide
+	// PfConfig::pruneExponent below bestExp is left out of the rest
+	template <class S, bool SPLIT>
+	forceinline
+	void applyTile(const Frame &f, int tile, int tileEnd, const Point2D_Wide<F> *cachedPos, float &bestExp) {
+		typedef typename S::Expected Expected;
+
+		int on = f.numTerms;
+		int nl = f.numCached;
+
+		// the split exponents are for display, which shows every particle
+		float pruneExp = pf.getConfig().pruneExponent;
+		bool pruning = !SPLIT && f.clear && pruneExp > 0.0f && on > OBS_BLOCK;
+		int lead = -1;		// the wide weighed in full first, if any
+
+		F *logw = f.logWeights;
+		F *dist = f.distanceExps;
+		ObservationWide block[OBS_BLOCK];
+		Expected cache[TILE_WIDES * MAX_CACHED_LANDMARKS];		// [particle][landmark]
+
+		if (on == 0 && f.clear) {
+			for (int p = tile; p < tileEnd; p++) {
+				logw[p] = L::zeros();
+				if (SPLIT) {
+					dist[p] = L::zeros();
+				}
+			}
+		}
+
+		for (int p = tile; p < tileEnd && nl > 0; p++) {
+			typename S::Pose pose = S::prepare(particles[p]);
+			for (int l = 0; l < nl; l++) {
+				cache[(p - tile) * nl + l] = S::expect(pose, cachedPos[l]);
+			}
+		}
+
+		for (int ob = 0; ob < on; ob += OBS_BLOCK) {
+			int bn = min(OBS_BLOCK, on - ob);
+			for (int k = 0; k < bn; k++) {
+				block[k] = getTerm(f, ob + k);
+			}
+
+			bool prune = pruning && ob > 0 && bestExp > -FLT_MAX;
+			F cutoffW = L::expand(prune ? bestExp - pruneExp : -FLT_MAX);
+
+			// the block is summed apart from the slot, whose exponents
+			// are only read and written once for it
+			bool fresh = (ob == 0 && f.clear);
+			for (int p = tile; p < tileEnd; p++) {
+				if (p == lead) {
+					continue;
+				}
+				if (prune && !L::any(logw[p] > cutoffW)) {
+					logw[p] = L::expand(PRUNED_EXPONENT);
+					continue;
+				}
+
+				const Expected *e = (nl > 0) ? &cache[(p - tile) * nl] : NULL;
+				ProbabilityExponents_Wide<F> acc = weighBlock<S>(p, block, bn, e);
+
+				F sum = getDistancePlusBearingExponent(acc);
+				logw[p] = fresh ? sum : logw[p] + sum;
+				if (SPLIT) {
+					dist[p] = fresh ? acc.distanceExp : dist[p] + acc.distanceExp;
+				}
+			}
+
+			if (pruning && ob == 0 && bestExp == -FLT_MAX) {
+				float top = L::reduce_max(getLaneExponents(logw, tile));
+				lead = tile;
+				for (int p = tile + 1; p < tileEnd; p++) {
+					float lanes = L::reduce_max(getLaneExponents(logw, p));
+					if (lanes > top) {
+						top = lanes;
+						lead = p;
+					}
+				}
+
+				const Expected *e = (nl > 0) ? &cache[(lead - tile) * nl] : NULL;
+				ObservationWide rest[OBS_BLOCK];
+				for (int rb = OBS_BLOCK; rb < on; rb += OBS_BLOCK) {
+					int rn = min(OBS_BLOCK, on - rb);
+					for (int k = 0; k < rn; k++) {
+						rest[k] = getTerm(f, rb + k);
+					}
+					logw[lead] += getDistancePlusBearingExponent(weighBlock<S>(lead, rest, rn, e));
+				}
+				bestExp = L::reduce_max(getLaneExponents(logw, lead));
+			}
+		}
+
+		if (pruning) {
+			F topW = L::expand(-FLT_MAX);
+			for (int p = tile; p < tileEnd; p++) {
+				topW = L::max(topW, getLaneExponents(logw, p));
+			}
+			bestExp = max(bestExp, L::reduce_max(topW));
+		}
+	}
+
+	template <class S>
+	forceinline
+	void applyTile(const Frame &f, int tile, int tileEnd, const Point2D_Wide<F> *cachedPos, float &bestExp) {
+		if (f.distanceExps != NULL) {
+			applyTile<S, true>(f, tile, tileEnd, cachedPos, bestExp);
+		} else {
+			applyTile<S, false>(f, tile, tileEnd, cachedPos, bestExp);
+		}
+	}
+
+	// applies the observations of the frame to the exponents of chunk c a
+	// tile at a time, if fused, also adds each tile to the chunk's pose
+	void updateChunk(Frame &f, int c, bool fused) {
+		bool vectorBearings = pf.getConfig().vectorBearings;
+
+		int begin, end;
+		getChunk(c, begin, end);
+
+		const F *logw = f.logWeights;
+
+		Point2D_Wide<F> cachedPos[MAX_CACHED_LANDMARKS];
+		for (int l = 0; l < f.numCached; l++) {
+			cachedPos[l] = Point2D_Wide<F>::expand(pf.getMap().refObjs[f.cachedIds[l]]);
+		}
+
+		// West's algorithm in each lane, the sums are of the weights over
+		// the weight of the lane's largest exponent so far
+		F               maxExpW    = L::expand(-FLT_MAX);
+		F               w_accumW   = L::zeros();
+		F               w2_accumW  = L::zeros();
+		Point2D_Wide<F> pos_meanW  = Point2D_Wide<F>(L::zeros(), L::zeros());
+		Point2D_Wide<F> pos_m2W    = Point2D_Wide<F>(L::zeros(), L::zeros());
+		Point2D_Wide<F> ori_accumW = Point2D_Wide<F>(L::zeros(), L::zeros());
+
+		// only the chunk's own particles are pruned against, so the chunks
+		// need not wait on each other and the same are pruned on any thread
+		float bestExp = -FLT_MAX;
+
+		for (int tile = begin; tile < end; tile += TILE_WIDES) {
+			int tileEnd = min(tile + TILE_WIDES, end);
+
+			if (vectorBearings) {
+				applyTile<VectorSensor>(f, tile, tileEnd, cachedPos, bestExp);
+			} else {
+				applyTile<AngleSensor>(f, tile, tileEnd, cachedPos, bestExp);
+			}
+
+			if (!fused) {
+				continue;
+			}
+
+			// a larger exponent in the tile scales the lane's sums down to
+			// its weight, once for the tile rather than for each wide
+			F tileMaxW = getMaxExponent(logw, tile, tileEnd, maxExpW);
+			F scale = L::exp(maxExpW - tileMaxW);
+			w_accumW   = w_accumW * scale;
+			w2_accumW  = w2_accumW * scale * scale;
+			pos_m2W    = pos_m2W * scale;
+			ori_accumW = ori_accumW * scale;
+			maxExpW    = tileMaxW;
+
+			for (int p = tile; p < tileEnd; p++) {
+				Particle_Wide<F> &part = particles[p];
+				F w = getWeight(logw, p, maxExpW);
+
+				// the share of the new weight, 0 until a lane has any weight
+				F total = w_accumW + w;
+				F r = L::blend(total > L::zeros(), w / total, L::zeros());
+
+				Point2D_Wide<F> d = part.pos - pos_meanW;
+				pos_meanW += d * r;
+				pos_m2W   += d * (part.pos - pos_meanW) * w;
+
+				ori_accumW += Point2D_Wide<F>::fromPolar(w, part.ang);
+				w2_accumW  += w * w;
+				w_accumW = total;
+			}
+		}
+
+		if (!fused) {
+			return;
+		}
+
+		// merge the lanes in order, scaled to the chunk's largest exponent
+		float maxExp = L::reduce_max(maxExpW);
+		F scaleW = L::exp(maxExpW - L::expand(maxExp));
+
+		WeightedStats stats;
+		for (int i = 0; i < L::WIDTH; i++) {
+			WeightedStats lane(L::get(w_accumW, i), pos_meanW[i], pos_m2W[i]);
+			stats.merge(lane.scaled(L::get(scaleW, i)));
+		}
+
+		f.sums[c].stats = stats;
+		f.sums[c].ori = (ori_accumW * scaleW).reduce_add();
+		f.sums[c].w2 = L::reduce_add(w2_accumW * scaleW * scaleW);
+		f.sums[c].maxExp = maxExp;
+	}
+
+	// moves the particles of chunk c by the odometry, with a generator for
+	// each chunk, so the noise does not depend on the mode or the threads
+	void moveChunk(const Motion &m, int c) {
+		int begin, end;
+		getChunk(c, begin, end);
+
+		sse4Rand rng(mixSeed(m.seed, c));
+		sse4Floats noise[3][TILE_PARTICLES / SSE_WIDTH];
+		const float *n0 = (const float *)noise[0];
+		const float *n1 = (const float *)noise[1];
+		const float *n2 = (const float *)noise[2];
+
+		F rot1  = L::expand(m.u.rot1);
+		F trans = L::expand(m.u.trans);
+		F rot2  = L::expand(m.u.rot2);
+
+		F sdRot1  = L::expand(m.sdRot1);
+		F sdTrans = L::expand(m.sdTrans);
+		F sdRot2  = L::expand(m.sdRot2);
+
+		for (int tile = begin; tile < end; tile += TILE_WIDES) {
+			int tileEnd = min(tile + TILE_WIDES, end);
+
+			// a whole tile of noise even for the last one, so the
+			// generator is in the same place for every lane width
+			for (int j = 0; j < 3; j++) {
+				for (int i = 0; i < TILE_PARTICLES / SSE_WIDTH; i++) {
+					noise[j][i] = rng.getNormal();
+				}
+			}
+
+			for (int p = tile; p < tileEnd; p++) {
+				Particle_Wide<F> &part = particles[p];
+				int o = (p - tile) * L::WIDTH;
+
+				// the rotations are on [-PI, PI] before the noise
+				F r1 = normalizeAngleRD(rot1 + L::load(n0 + o) * sdRot1);
+				F t  = trans + L::load(n1 + o) * sdTrans;
+				F r2 = normalizeAngleRD(rot2 + L::load(n2 + o) * sdRot2);
+
+				F heading = normalizeAngleRD(part.ang + r1);
+
+				F s, co;
+				L::sincos(heading, s, co);
+
+				part.pos += Point2D_Wide<F>(co, s) * t;
+				part.ang = normalizeAngleRD(heading + r2);
+			}
+		}
+	}
+
+	// the particles [first, first + count) of chunk c
+	forceinline void getChunkParticles(int c, int &first, int &count) const {
+		first = c * CHUNK_PARTICLES;
+		count = min(CHUNK_PARTICLES, numParticles - first);
+	}
+
+	// the running sums of the weights of chunk c, over the weight of the
+	// last frame's largest exponent, four at a time in an SSE register
+	void sumChunk(Resampling &r, int c) {
+		int begin, end;
+		getChunk(c, begin, end);
+
+		int first, count;
+		getChunkParticles(c, first, count);
+
+		float *running = cdf + first;
+		int stored = (end - begin) * L::WIDTH;
+		F maxExpW = L::expand(maxExp);
+
+		for (int i = begin; i < end; i++) {
+			L::store(running + (i - begin) * L::WIDTH, getWeight(r.logWeights, i, maxExpW));
+		}
+		for (int i = stored; i % SSE_WIDTH != 0; i++) {
+			running[i] = 0.0f;
+		}
+
+		// each group of four carries on from the last sum of the one before
+		sse4Floats carry = sse4Floats::zeros();
+		for (int i = 0; i < stored; i += SSE_WIDTH) {
+			sse4Floats s = sse4Floats(running + i).scan_add() + carry;
+			store4(running + i, s);
+			carry = s.shuffle<3, 3, 3, 3>();
+		}
+		r.chunks[c].total = running[count - 1];
+	}
+
+	// stratified, the offset of draw k into its stratum, on [0, 1), hashed
+	// from k, 1 past the last draw
+	forceinline float getOffset(const Resampling &r, int k) const {
+		if (k >= r.numDraws) {
+			return 1.0f;
+		}
+		return (float)(mixSeed(r.seed, max(k, 0)) >> 8) * (1.0f / 16777216.0f);
+	}
+
+	// the draws before the particle of chunk c whose running sum, in draws
+	// from the start of the chunk, is d, not yet clamped to the chunk's
+	forceinline int countDraws(const Resampling &r, int c, float d) const {
+		const ChunkDraws &cd = r.chunks[c];
+		int t = (int)d;		// d is not negative
+		int k = cd.base + t;
+
+		// stratified, draw k is before the particle if its offset is
+		if (r.stratified) {
+			return k + (getOffset(r, k) < d - t);
+		}
+		return k + ((float)t < d);
+	}
+
+	// the draws before particle i of chunk c and after the chunk's first,
+	// the last particle takes every draw up to the next chunk's, which the
+	// sums may round short of
+	forceinline int getDraws(const Resampling &r, int c, int i) const {
+		const ChunkDraws &cd = r.chunks[c];
+		const ChunkDraws &next = r.chunks[c + 1];
+
+		if (i == min(CHUNK_PARTICLES, numParticles - c * CHUNK_PARTICLES) - 1) {
+			return next.first;
+		}
+		float d = cd.frac + cdf[c * CHUNK_PARTICLES + i] * r.invStep;
+		return clamp(countDraws(r, c, d), cd.first, next.first);
+	}
+
+	// KLD, sets the bit of the bin of particle i in chunk c's set, the
+	// poses off the grass go in the bins at its edges
+	forceinline void addBin(const Resampling &r, int c, int i) const {
+		const Particle_Wide<F> &p = particles[i / L::WIDTH];
+		int l = i % L::WIDTH;
+
+		Point2D pos = Point2D(L::get(p.pos.x, l), L::get(p.pos.y, l)) - r.binOrigin;
+		int bx = clamp((int)(pos.x * r.invBinSize), 0, r.binsX - 1);
+		int by = clamp((int)(pos.y * r.invBinSize), 0, r.binsY - 1);
+		int ba = clamp((int)((L::get(p.ang, l) + M_PI) * r.invBinAngle), 0, r.binsA - 1);
+
+		int b = (ba * r.binsY + by) * r.binsX + bx;
+		r.bins[c * r.binWords + b / 32] |= 1u << (b % 32);
+	}
+
+	// marks the first draw of each particle of chunk c with the particle,
+	// without branching on the weights, and with KLD sets the bins drawn
+	void markChunk(Resampling &r, int c) {
+		int first, count;
+		getChunkParticles(c, first, count);
+
+		float *running = cdf + first;
+		int spareMark = r.numDraws + c;
+		int lo = r.chunks[c].first;
+		int hi = r.chunks[c + 1].first;
+
+		memset(marks + lo, 0xff, sizeof(int) * (hi - lo));
+		if (r.bins != NULL) {
+			memset(r.bins + c * r.binWords, 0, sizeof(unsigned int) * r.binWords);
+		}
+
+		sse4Floats frac = sse4Floats::expand(r.chunks[c].frac);
+		sse4Floats invStep = sse4Floats::expand(r.invStep);
+		sse4Ints base = sse4Ints::expand(r.chunks[c].base);
+
+		// the lanes are read back through memory, the stack has no 16-byte
+		// alignment to count on
+		int draws[SSE_WIDTH];
+
+		int prev = lo;
+		for (int i = 0; i < count - 1; i += SSE_WIDTH) {
+			sse4Floats d = frac + sse4Floats(running + i) * invStep;
+			sse4Ints t = cast_f2i(d);
+			sse4Ints k = base + t;
+
+			// the masks are -1 where the draw at k is before the particle
+			if (r.stratified) {
+				_mm_storeu_si128((__m128i *)draws, k.data);
+				sse4Floats u = sse4Floats(getOffset(r, draws[0]), getOffset(r, draws[1]),
+										  getOffset(r, draws[2]), getOffset(r, draws[3]));
+				k -= sse4Ints::cast(u < d - cast_i2f(t));
+			} else {
+				k -= sse4Ints::cast(cast_i2f(t) < d);
+			}
+			k = max4(min4(k, sse4Ints::expand(hi)), sse4Ints::expand(lo));
+			_mm_storeu_si128((__m128i *)draws, k.data);
+
+			int lanes = min(SSE_WIDTH, count - 1 - i);
+			for (int l = 0; l < lanes; l++) {
+				int next = draws[l];
+				marks[(next > prev) ? prev : spareMark] = first + i + l;
+				if (r.bins != NULL && next > prev) {
+					addBin(r, c, first + i + l);
+				}
+				prev = next;
+			}
+		}
+
+		if (hi > prev) {
+			marks[prev] = first + count - 1;
+			if (r.bins != NULL) {
+				addBin(r, c, first + count - 1);
+			}
+		}
+	}
+
+	// the particle drawn at draw j, the first whose draws go past it
+	int findDrawn(const Resampling &r, int j) const {
+		// the last chunk whose draws start at or before j
+		int lo = 0;
+		int hi = numChunks - 1;
+		while (lo < hi) {
+			int mid = (lo + hi + 1) / 2;
+			if (r.chunks[mid].first <= j) {
+				lo = mid;
+			} else {
+				hi = mid - 1;
+			}
+		}
+
+		int c = lo;
+		int first, count;
+		getChunkParticles(c, first, count);
+
+		lo = 0;
+		hi = count - 1;
+		while (lo < hi) {
+			int mid = (lo + hi) / 2;
+			if (getDraws(r, c, mid) > j) {
+				hi = mid;
+			} else {
+				lo = mid + 1;
+			}
+		}
+		return first + lo;
+	}
+
+	// the particles of chunk c of the new set, draw j is of the running max
+	// of the marks up to it, lanes past the last particle repeat it
+	void drawChunk(Resampling &r, int c) {
+		int first = c * CHUNK_PARTICLES;
+		int count = min(CHUNK_PARTICLES, r.numDraws - first);
+
+		int picked[TILE_PARTICLES];
+		int drawn = findDrawn(r, first);
+
+		for (int tile = first; tile < first + count; tile += TILE_PARTICLES) {
+			int tileEnd = min(tile + TILE_PARTICLES, first + count);
+
+			for (int j = tile; j < tileEnd; j++) {
+				drawn = max(drawn, marks[j]);
+				picked[j - tile] = drawn;
+			}
+
+			for (int w = tile / L::WIDTH; w * L::WIDTH < tileEnd; w++) {
+				float x[L::WIDTH];
+				float y[L::WIDTH];
+				float a[L::WIDTH];
+
+				for (int k = 0; k < L::WIDTH; k++) {
+					int i = picked[min(w * L::WIDTH + k, tileEnd - 1) - tile];
+					const Particle_Wide<F> &src = particles[i / L::WIDTH];
+
+					x[k] = L::get(src.pos.x, i % L::WIDTH);
+					y[k] = L::get(src.pos.y, i % L::WIDTH);
+					a[k] = L::get(src.ang, i % L::WIDTH);
+				}
+
+				r.out[w] = Particle_Wide<F>(Point2D_Wide<F>(L::load(x), L::load(y)), L::load(a));
+			}
+		}
+	}
+
+	// lays out numDraws draws into the total weight, offset is set, each
+	// chunk's draws start where the one before ends
+	void layoutDraws(Resampling &r, int numDraws, double total) {
+		allocResampling(numDraws);
+
+		r.numDraws = numDraws;
+		r.step = total / numDraws;
+		r.invStep = (float)(1.0 / r.step);
+
+		r.chunks[0].first = 0;
+		r.chunks[numChunks].first = numDraws;
+
+		for (int c = 0; c < numChunks; c++) {
+			ChunkDraws &cd = r.chunks[c];
+			double a = cd.start / r.step - r.offset;
+			cd.base = (int)floor(a);
+			cd.frac = (float)(a - cd.base);
+
+			if (c + 1 < numChunks) {
+				int k = countDraws(r, c, cd.frac + cd.total * r.invStep);
+				r.chunks[c + 1].first = clamp(k, cd.first, numDraws);
+			}
+		}
+	}
+
+	// marks the draws laid out in r and returns how many particles
+	// KLD-sampling needs for the bins they draw
+	int getKldDraws(Resampling &r) {
+		const PfConfig &config = pf.getConfig();
+		const Rectangle &grass = pf.getMap().grass;
+
+		r.binOrigin = grass.getBottomLeft();
+		r.invBinSize = 1.0f / config.kldBinSize;
+		r.invBinAngle = 1.0f / config.kldBinAngle;
+		r.binsX = max((int)ceilf(grass.getWidth() * r.invBinSize), 1);
+		r.binsY = max((int)ceilf(grass.getHeight() * r.invBinSize), 1);
+		r.binsA = max((int)ceilf(2.0f * M_PI * r.invBinAngle), 1);
+		r.binWords = (r.binsX * r.binsY * r.binsA + 31) / 32;
+		r.bins = new unsigned int[numChunks * r.binWords];
+
+		pf.getThreadPool().run(markTask, &r, numChunks, stages.resample.getName());
+
+		// the bins of every chunk, in the first chunk's set
+		for (int c = 1; c < numChunks; c++) {
+			for (int w = 0; w < r.binWords; w++) {
+				r.bins[w] |= r.bins[c * r.binWords + w];
+			}
+		}
+
+		int k = 0;
+		for (int w = 0; w < r.binWords; w++) {
+			k += countBits(r.bins[w]);
+		}
+
+		delete[] r.bins;
+		r.bins = NULL;
+
+		int n = getKldParticles(k, config.kldError, config.kldQuantile);
+		return max(min(n, min(config.maxParticles, MAX_NUM_PARTICLES)), max(config.minParticles, 1));
+	}
+
+	// replaces the particles with n in wides, which the kernel takes over,
+	// the buffers sized for the old ones are freed
+	void adopt(Particle_Wide<F> *wides, int n) {
+		release();
+		setNumParticles(n);
+		particles = wides;
+
+		allocSlot(0);
+		shownSlot = 0;
+	}
+
+	// the weighted sums of the positions and angles of chunk c
+	void meanChunk(Frame &f, int c) {
+		Point2D_Wide<F> pos_accumW = Point2D_Wide<F>(L::zeros(), L::zeros());
+		Point2D_Wide<F> ori_accumW = Point2D_Wide<F>(L::zeros(), L::zeros());
+		F                 w_accumW = L::zeros();		// weight accumulator
+		F                w2_accumW = L::zeros();
+
+		int begin, end;
+		getChunk(c, begin, end);
+
+		// the sums are of the weights over the weight of the chunk's
+		// largest exponent
+		float maxExp = L::reduce_max(getMaxExponent(f.logWeights, begin, end, L::expand(-FLT_MAX)));
+		F     maxExpW = L::expand(maxExp);
+
+		for (int i = begin; i < end; i++) {
+			Point2D_Wide<F> &pos = particles[i].pos;
+			F               &ang = particles[i].ang;
+			F                w   = getWeight(f.logWeights, i, maxExpW);
+
+			pos_accumW += pos * w;
+			ori_accumW += Point2D_Wide<F>::fromPolar(w, ang);
+			w_accumW   += w;
+			w2_accumW  += w * w;
+		}
+
+		f.sums[c].pos = pos_accumW.reduce_add();
+		f.sums[c].ori = ori_accumW.reduce_add();
+		f.sums[c].w   = L::reduce_add(w_accumW);
+		f.sums[c].w2  = L::reduce_add(w2_accumW);
+		f.sums[c].maxExp = maxExp;
+	}
+
+	// the largest exponent of the chunks, which the sums of each are scaled
+	// to, as in log-sum-exp
+	float getMaxExponent(const Frame &f) const {
+		float maxExp = -FLT_MAX;
+		for (int c = 0; c < numChunks; c++) {
+			maxExp = max(maxExp, f.sums[c].maxExp);
+		}
+		return maxExp;
+	}
+
+	// normalizes the weights and computes the weighted mean pose and the
+	// effective sample size
+	void reduceMean(Frame &f) {
+		Point2D  pos_accum = Point2D(0.0f, 0.0f);
+		Vector2D ori_accum = Vector2D(0.0f, 0.0f);
+		float      w_accum = 0.0f;
+		float     w2_accum = 0.0f;
+
+		f.maxExp = getMaxExponent(f);
+		for (int c = 0; c < numChunks; c++) {
+			float s = expf(f.sums[c].maxExp - f.maxExp);
+			pos_accum += f.sums[c].pos * s;
+			ori_accum += f.sums[c].ori * s;
+			w_accum   += f.sums[c].w * s;
+			w2_accum  += f.sums[c].w2 * s * s;
+		}
+		assert(w_accum != 0.0f);
+		assert(ori_accum.getMagnitude() != 0.0f);
+
+		f.inv_total_w = 1.0f / w_accum;
+
+		f.pos_mn = pos_accum * f.inv_total_w;
+		f.ang_mn = ori_accum.getDirection();
+		f.ess = getEss(w_accum, w2_accum);
+	}
+
+	// the weighted squared deviations from the mean pose of chunk c
+	void stdDevChunk(Frame &f, int c) {
+		Point2D_Wide<F> pos_mnW = Point2D_Wide<F>::expand(f.pos_mn);
+		F               ang_mnW = L::expand(f.ang_mn);
+
+		F               maxExpW = L::expand(f.maxExp);
+
+		Point2D_Wide<F> pd2_accumW = Point2D_Wide<F>(L::zeros(), L::zeros());
+		F               ad2_accumW = L::zeros();
+
+		int begin, end;
+		getChunk(c, begin, end);
+
+		for (int i = begin; i < end; i++) {
+			Point2D_Wide<F> &pos = particles[i].pos;
+			F               &ang = particles[i].ang;
+			F                w   = getWeight(f.logWeights, i, maxExpW);
+
+			Point2D_Wide<F> pd = pos - pos_mnW;
+			pd2_accumW += pd * pd * w;
+
+			F ad = absMinAngleDiff(ang, ang_mnW);
+			ad2_accumW += ad * ad * w;
+		}
+
+		f.sums[c].pd2 = pd2_accumW.reduce_add();
+		f.sums[c].ad2 = L::reduce_add(ad2_accumW);
+	}
+
+	// merges the fused statistics of the chunks into the pose, the angle's
+	// spread is the circular standard deviation, sqrt(-2 ln R), where R is
+	// the length of the weighted mean of the angles' unit vectors
+	void reduceFused(Frame &f) {
+		WeightedStats stats;
+		Vector2D ori_accum = Vector2D(0.0f, 0.0f);
+		float     w2_accum = 0.0f;
+
+		f.maxExp = getMaxExponent(f);
+		for (int c = 0; c < numChunks; c++) {
+			float s = expf(f.sums[c].maxExp - f.maxExp);
+			stats.merge(f.sums[c].stats.scaled(s));
+			ori_accum += f.sums[c].ori * s;
+			w2_accum  += f.sums[c].w2 * s * s;
+		}
+		assert(stats.w != 0.0f);
+		assert(ori_accum.getMagnitude() != 0.0f);
+
+		Point2D pos_mn = stats.mean;
+		AngRad  ang_mn = ori_accum.getDirection();
+
+		float R = min(ori_accum.getMagnitude() / stats.w, 1.0f);
+
+		Point2D pos_sd = sqrt(stats.getVariance());
+		AngRad  ang_sd = sqrtf(-2.0f * logf(R));
+
+		f.pose = RobotPose(pos_mn, ang_mn, pos_sd, ang_sd);
+		f.ess = getEss(stats.w, w2_accum);
+	}
+
+	// computes the weighted standard deviation and the pose
+	void reducePose(Frame &f) {
+		Point2D pd2_accum = Point2D(0.0f, 0.0f);
+		AngRad  ad2_accum = 0.0f;
+
+		for (int c = 0; c < numChunks; c++) {
+			pd2_accum += f.sums[c].pd2;
+			ad2_accum += f.sums[c].ad2;
+		}
+
+		Point2D pos_var = pd2_accum * f.inv_total_w;
+		AngRad  ang_var = ad2_accum * f.inv_total_w;
+
+		Point2D pos_sd = sqrt(pos_var);
+		AngRad  ang_sd = sqrt(ang_var);
+
+		f.pose = RobotPose(f.pos_mn, f.ang_mn, pos_sd, ang_sd);
+	}
+
+	// entry points for the thread pool, arg is the Frame
+	static void updateTask(void *arg, int c) {
+		Frame *f = (Frame *)arg;
+		f->kernel->updateChunk(*f, c, false);
+	}
+
+	static void fusedTask(void *arg, int c) {
+		Frame *f = (Frame *)arg;
+		f->kernel->updateChunk(*f, c, true);
+	}
+
+	static void moveTask(void *arg, int c) {
+		Motion *m = (Motion *)arg;
+		m->kernel->moveChunk(*m, c);
+	}
+
+	static void sumTask(void *arg, int c) {
+		Resampling *r = (Resampling *)arg;
+		r->kernel->sumChunk(*r, c);
+	}
+
+	static void markTask(void *arg, int c) {
+		Resampling *r = (Resampling *)arg;
+		r->kernel->markChunk(*r, c);
+	}
+
+	static void drawTask(void *arg, int c) {
+		Resampling *r = (Resampling *)arg;
+		r->kernel->drawChunk(*r, c);
+	}
+
+	static void reduceFusedTask(void *arg, int c) {
+		(void)c;
+		Frame *f = (Frame *)arg;
+		f->kernel->reduceFused(*f);
+	}
+
+	static void meanTask(void *arg, int c) {
+		Frame *f = (Frame *)arg;
+		f->kernel->meanChunk(*f, c);
+	}
+
+	static void reduceMeanTask(void *arg, int c) {
+		(void)c;
+		Frame *f = (Frame *)arg;
+		f->kernel->reduceMean(*f);
+	}
+
+	static void stdDevTask(void *arg, int c) {
+		Frame *f = (Frame *)arg;
+		f->kernel->stdDevChunk(*f, c);
+	}
+
+	static void reducePoseTask(void *arg, int c) {
+		(void)c;
+		Frame *f = (Frame *)arg;
+		f->kernel->reducePose(*f);
+	}
 
+	// the particle updates of a counter region, the counters only follow
+	// the calling thread, so 0 unless it runs them all
+	unsigned long long getCountedUpdates(unsigned long long n) const {
+		return (pf.getThreadPool().getNumThreads() == 1) ? n : 0;
+	}
+
+	// Computes the weighted mean of the robot pose (location and bearing) and
+	// the weighted standard deviation of the robot pose.  This
+	// version computes the values using a standard two-pass algorithm
+	// which computes the mean in the first pass and the standard deviation
+	// in the second pass.
+	noinline
+	RobotPose estimatePose(Frame &f) {
+		PERF_REGION(stages.poseRegion, getCountedUpdates(numParticles));
 
+		ThreadPool &pool = pf.getThreadPool();
+
+		// compute weighted mean
+		{
+			PROFILE_ZONE(stages.mean);
+			pool.run(meanTask, &f, numChunks, stages.mean.getName());
+			reduceMean(f);
+		}
+
+		// compute weighted standard deviation
+		{
+			PROFILE_ZONE(stages.stdDev);
+			pool.run(stdDevTask, &f, numChunks, stages.stdDev.getName());
+			reducePose(f);
+		}
+
+		return f.pose;
+	}
+
+public:
+	PfKernel_Wide(const ParticleFilter &in_pf, const char *modeName)
+		: particles(NULL), spare(NULL), cdf(NULL), marks(NULL), numMarks(0), shownSlot(0), ess(-1.0f), maxExp(0.0f), carriedEnd(-1), numParticles(0), numWides(0), numChunks(0),
+		  tailWide(-1), tailCount(0), pf(in_pf), stages(modeName)
+	{
+		for (int s = 0; s < NUM_SLOTS; s++) {
+			logWeights[s] = NULL;
+			distanceExps[s] = NULL;
+			sums[s] = NULL;
+			slotAges[s] = -1;
+		}
+	}
+
+	~PfKernel_Wide() {
+		release();
+	}
+
+	void init(const Particle *in, int n) {
+		assert(n > 0);
+		release();
+		setNumParticles(n);
+
+		particles = (Particle_Wide<F> *)malloc16(sizeof(Particle_Wide<F>) * numWides);
+		dieIf(particles == NULL, "could not allocate the particles");
+
+		for (int i = 0; i < numWides; i++) {
+			int j = i * L::WIDTH;
+			particles[i] = Particle_Wide<F>(in + j, min(n - j, (int)L::WIDTH));
+		}
+
+		// the other slots are only needed by runFrames()
+		allocSlot(0);
+		shownSlot = 0;
+		carriedEnd = -1;
+	}
+
+	void release() {
+		free16(particles);
+		free16(spare);
+		free16(cdf);
+		free16(marks);
+		particles = NULL;
+		spare = NULL;
+		cdf = NULL;
+		marks = NULL;
+		numMarks = 0;
+
+		for (int s = 0; s < NUM_SLOTS; s++) {
+			free16(logWeights[s]);
+			free16(distanceExps[s]);
+			free16(sums[s]);
+			logWeights[s] = NULL;
+			distanceExps[s] = NULL;
+			sums[s] = NULL;
+		}
+
+		numParticles = 0;
+		numWides = 0;
+		numChunks = 0;
+		tailWide = -1;
+		tailCount = 0;
+		ess = -1.0f;
+		maxExp = 0.0f;		// of the exponents allocSlot() clears
+	}
+
+	int getNumParticles() const {
+		return numParticles;
+	}
+
+	void invalidate() {
+		for (int s = 0; s < NUM_SLOTS; s++) {
+			slotAges[s] = -1;
+		}
+		carriedEnd = -1;
+	}
+
+	// before the particles move or are drawn again, keeps the exponents of
+	// the last frame in slot 0, or if there is none, the window but for
+	// its newest observation with the particles equal
+	void carry() {
+		if (carriedEnd >= 0) {
+			return;
+		}
+
+		if (slotAges[shownSlot] >= 0) {
+			if (shownSlot != 0) {
+				memcpy(logWeights[0], logWeights[shownSlot], sizeof(F) * numWides);
+				if (distanceExps[0] != NULL) {
+					memcpy(distanceExps[0], distanceExps[shownSlot], sizeof(F) * numWides);
+				}
+			}
+
+			const ObservationWindow &w = slotWindows[shownSlot];
+			carriedEnd = w.getBase() + w.getSize();
+		} else {
+			clearSlot(0);
+			maxExp = 0.0f;
+
+			const ObservationWindow &w = pf.getObservationWindow();
+			carriedEnd = max(w.getBase() + w.getSize() - 1, 0);
+		}
+		shownSlot = 0;
+	}
+
+	void predict(const Odometry &u, unsigned int seed) {
+		PROFILE_ZONE(stages.motion);
+		const PfConfig &config = pf.getConfig();
+
+		// the exponents are of where the particles were
+		carry();
+
+		Motion m;
+		m.kernel = this;
+		m.u = Odometry(wrapAngle(u.rot1), u.trans, wrapAngle(u.rot2));
+		m.seed = seed;
+
+		float r1 = m.u.rot1 * m.u.rot1;
+		float t  = m.u.trans * m.u.trans;
+		float r2 = m.u.rot2 * m.u.rot2;
+
+		m.sdRot1  = sqrtf(config.rotRotNoise * r1 + config.rotTransNoise * t);
+		m.sdTrans = sqrtf(config.transTransNoise * t + config.transRotNoise * (r1 + r2));
+		m.sdRot2  = sqrtf(config.rotRotNoise * r2 + config.rotTransNoise * t);
+
+		pf.getThreadPool().run(moveTask, &m, numChunks, stages.motion.getName());
+		ess = -1.0f;
+	}
+
+	bool resample(ResampleMethod method, unsigned int seed) {
+		PROFILE_ZONE(stages.resample);
+		ThreadPool &pool = pf.getThreadPool();
+
+		allocResampling(numParticles);
+
+		// the particles are drawn by the observations they were weighed
+		// against, which they carry from then on, unless they were not
+		bool weighed = (carriedEnd >= 0 || slotAges[shownSlot] >= 0);
+		if (weighed) {
+			carry();
+		}
+
+		Resampling r;
+		r.kernel = this;
+		r.logWeights = logWeights[shownSlot];
+		r.out = spare;
+		r.chunks = new ChunkDraws[numChunks + 1];
+		r.stratified = (method == RESAMPLE_STRATIFIED);
+		r.seed = seed;
+		r.bins = NULL;
+
+		pool.run(sumTask, &r, numChunks, stages.resample.getName());
+
+		double total = 0.0;
+		for (int c = 0; c < numChunks; c++) {
+			r.chunks[c].start = total;
+			total += r.chunks[c].total;
+		}
+
+		// also false for weights that are not finite
+		bool drawn = (total > 0.0 && total <= DBL_MAX);
+		if (drawn) {
+			RandGen rng(seed);
+			r.offset = r.stratified ? 0.0f : rng.getRand(0.0f, 1.0f);
+			layoutDraws(r, numParticles, total);
+
+			// KLD, the bins are those of as many draws as there are
+			// particles, whose marks are kept if it needs as many again
+			int numDraws = numParticles;
+			bool marked = false;
+			if (pf.getConfig().kldError > 0.0f) {
+				numDraws = getKldDraws(r);
+				marked = true;
+			}
+
+			if (numDraws != numParticles) {
+				layoutDraws(r, numDraws, total);
+				marked = false;
+
+				int wides = (numDraws + L::WIDTH - 1) / L::WIDTH;
+				r.out = (Particle_Wide<F> *)malloc16(sizeof(Particle_Wide<F>) * wides);
+				dieIf(r.out == NULL, "could not allocate the particles");
+			}
+
+			if (!marked) {
+				pool.run(markTask, &r, numChunks, stages.resample.getName());
+			}
+			pool.run(drawTask, &r, (numDraws + CHUNK_PARTICLES - 1) / CHUNK_PARTICLES,
+					 stages.resample.getName());
+
+			if (numDraws == numParticles) {
+				swap(particles, spare);
+			} else {
+				adopt(r.out, numDraws);
+			}
+
+			// the drawn particles are equally likely given what is carried
+			if (weighed) {
+				clearSlot(0);
+				maxExp = 0.0f;
+			} else {
+				invalidate();
+			}
+			ess = -1.0f;
+		}
+
+		delete[] r.chunks;
+		return drawn;
+	}
+
+	noinline
+	RobotPose run() {
+		PROFILE_ZONE(stages.frame);
+
+		Frame f = makeFrame(0, pf.getObservationWindow());
+		shownSlot = 0;
+
+		if (pf.getConfig().fusedPose) {
+			PROFILE_ZONE(stages.fused);
+			PERF_REGION(stages.observationsRegion, getCountedUpdates((unsigned long long)numParticles * f.window.getSize()));
+
+			pf.getThreadPool().run(fusedTask, &f, numChunks, stages.fused.getName());
+			reduceFused(f);
+			ess = f.ess;
+			maxExp = f.maxExp;
+			return f.pose;
+		}
+
+		// weigh the particles against each observation in the window
+		{
+			PROFILE_ZONE(stages.observations);
+			PERF_REGION(stages.observationsRegion, getCountedUpdates((unsigned long long)numParticles * f.window.getSize()));
+
+			pf.getThreadPool().run(updateTask, &f, numChunks, stages.observations.getName());
+		}
+
+		RobotPose pose = estimatePose(f);
+		ess = f.ess;
+		maxExp = f.maxExp;
+		return pose;
+	}
+
+	noinline
+	void runFrames(const ObservationWindow *windows, RobotPose *poses, int numFrames) {
+		PROFILE_ZONE(stages.frames);
+
+		for (int s = 0; s < NUM_SLOTS; s++) {
+			allocSlot(s);
+		}
+
+		bool fused = pf.getConfig().fusedPose;
+
+		Frame *frames = new Frame[numFrames];
+		TaskGraph graph(numFrames * (3 * numChunks + 2), numFrames * (5 * numChunks + 1));
+
+		// the std dev and pose tasks of the last frame in each slot, which
+		// the next frame in the slot must wait on before reusing it
+		Task **lastStdDev = new Task *[NUM_SLOTS * numChunks];
+		Task *lastPose[NUM_SLOTS];
+
+		// carried exponents are one running sum, which every frame adds to
+		int numSlots = (carriedEnd >= 0) ? 1 : NUM_SLOTS;
+
+		for (int t = 0; t < numFrames; t++) {
+			int slot = t % numSlots;
+			bool reused = (t >= numSlots);
+
+			Frame &f = frames[t];
+			f = makeFrame(slot, windows[t]);
+
+			// fused, each chunk is one task and the next frame in the slot
+			// only has to wait for the pose
+			if (fused) {
+				Task *pose = graph.add(reduceFusedTask, &f, 0, stages.fused.getName());
+
+				for (int c = 0; c < numChunks; c++) {
+					Task *u = graph.add(fusedTask, &f, c, stages.fused.getName());
+					graph.depend(pose, u);
+
+					if (reused) {
+						graph.depend(u, lastPose[slot]);
+					}
+				}
+				lastPose[slot] = pose;
+				continue;
+			}
+
+			Task *mean = graph.add(reduceMeanTask, &f, 0, stages.mean.getName());
+			Task *pose = graph.add(reducePoseTask, &f, 0, stages.stdDev.getName());
+			if (reused) {
+				graph.depend(mean, lastPose[slot]);
+			}
+
+			// each chunk's share of the mean only waits on its own weights
+			for (int c = 0; c < numChunks; c++) {
+				Task *u = graph.add(updateTask, &f, c, stages.observations.getName());
+				Task *m = graph.add(meanTask, &f, c, stages.mean.getName());
+				graph.depend(m, u);
+				graph.depend(mean, m);
+
+				if (reused) {
+					graph.depend(u, lastStdDev[slot * numChunks + c]);
+				}
+			}
+
+			for (int c = 0; c < numChunks; c++) {
+				Task *sd = graph.add(stdDevTask, &f, c, stages.stdDev.getName());
+				graph.depend(sd, mean);
+				graph.depend(pose, sd);
+
+				lastStdDev[slot * numChunks + c] = sd;
+			}
+			lastPose[slot] = pose;
+		}
+
+		pf.getThreadPool().run(graph);
+
+		for (int t = 0; t < numFrames; t++) {
+			poses[t] = frames[t].pose;
+		}
+		shownSlot = (numFrames - 1) % numSlots;
+		ess = frames[numFrames - 1].ess;
+		maxExp = frames[numFrames - 1].maxExp;
+
+		delete[] lastStdDev;
+		delete[] frames;
+	}
+
+	float getEffectiveSampleSize() const {
+		return ess;
+	}
+
+	Particle getParticle(int index) const {
+		assert(index >= 0 && index < numParticles);
+		return particles[index / L::WIDTH][index % L::WIDTH];
+	}
+
+	ProbabilityExponents getProbabilityExponents(int index) const {
+		assert(index >= 0 && index < numParticles);
+		int w = index / L::WIDTH;
+		int lane = index % L::WIDTH;
+
+		float sum = L::get(logWeights[shownSlot][w], lane);
+		if (distanceExps[shownSlot] == NULL) {
+			return ProbabilityExponents(sum, 0.0f);
+		}
+
+		float distanceExp = L::get(distanceExps[shownSlot][w], lane);
+		return ProbabilityExponents(distanceExp, sum - distanceExp);
+	}
+};
+
+
+//--- MODES ---//
+
+// creates the filter of a mode, its particles are loaded on first use
+static
+PfKernel *newKernel(PfMode mode, const ParticleFilter &pf) {
+	switch (mode) {
+		case PF_SCALAR: return new PfKernel_Wide<float>      (pf, PF_MODE_STRINGS[mode]);
+		case PF_SSE:    return new PfKernel_Wide<sse4Floats> (pf, PF_MODE_STRINGS[mode]);
+		case PF_SSE8:   return new PfKernel_Wide<sse8Floats> (pf, PF_MODE_STRINGS[mode]);
+		case PF_SSE16:  return new PfKernel_Wide<sse16Floats>(pf, PF_MODE_STRINGS[mode]);
+		default:
+			error("unknown particle filter mode");
+			return NULL;
+	}
+}
+
+
 //--- EXTERNAL INTERFACE ---//
 
-void seedParticleGen(unsigned int rand_seed) {
-	seedRand(rand_seed);
+const FieldMap &getDefaultFieldMap() {
+	return DEFAULT_FIELD_MAP;
 }
 
-void initAllParticles() {
-	initScalarParticles();		// must be called first
-	initSseParticles();			// must be called second
+RobotPose getActualPose() {
+	return RobotPose(ROBOT_POS, ROBOT_ANGLE, Point2D(0.0f, 0.0f), 0.0f);
+}
+
+
+//--- PARTICLE FILTER OBJECT ---//
+
+// the control register is per-thread
+static
+void initPfThread(void *arg) {
+	(void)arg;
+	SSE::init();
+}
+
+ParticleFilter::ParticleFilter(const PfConfig &in_config, const FieldMap &in_map)
+	: map(in_map), config(in_config), obsData(NULL), obsWindow(0, 0, 0),
+	  initialParticles(NULL), rng(in_config.seed), fps(0.0f), numDraws(0),
+	  numEssChecks(0), numResamples(0),
+	  pool(in_config.numThreads, initPfThread, NULL)
+{
+	for (int m = 0; m < NUM_PF_MODES; m++) {
+		kernels[m] = newKernel((PfMode)m, *this);
+	}
+
+	setMode(config.mode);
+	initParticles(config.numParticles);
 }
 
-// loads the observation data from the given file and initializes
-// the observation data array and observation data array size
-void loadObservationData(const char *filename) {
+ParticleFilter::~ParticleFilter() {
+	for (int m = 0; m < NUM_PF_MODES; m++) {
+		delete kernels[m];
+	}
+
+	free16(initialParticles);
+	free16(obsData);
+}
+
+// the kernel of a mode, the starting particles are copied in on first
+// use, so large particle counts only take memory in the modes that run
+PfKernel *ParticleFilter::getKernel(PfMode mode) {
+	PfKernel *k = kernels[mode];
+	if (k->getNumParticles() == 0) {
+		k->init(initialParticles, config.numParticles);
+	}
+
+	return k;
+}
+
+void ParticleFilter::initParticles(int n) {
+	n = clamp(n, 1, MAX_NUM_PARTICLES);
+
+	free16(initialParticles);
+	initialParticles = (Particle *)malloc16(sizeof(Particle) * n);
+	dieIf(initialParticles == NULL, "could not allocate the particles");
+	config.numParticles = n;
+
+	for (int i = 0; i < n; i++) {
+		initialParticles[i].placeRandomly(map.grass, rng);
+	}
+
+	// every mode starts from the same particles, see getKernel()
+	for (int m = 0; m < NUM_PF_MODES; m++) {
+		kernels[m]->release();
+	}
+}
+
+bool ParticleFilter::setObservations(const Observation *obs, int n) {
+	for (int i = 0; i < n; i++) {
+		if (obs[i].id < 0 || obs[i].id >= map.numRefObjs) {
+			printf("num reference objects: %d, bad index: %d\n",
+				   map.numRefObjs, obs[i].id);
+			return false;
+		}
+	}
+
+	free16(obsData);
+	obsData = (Observation *)malloc16(sizeof(Observation) * max(n, 1));
+	dieIf(obsData == NULL, "could not allocate the observations");
+
+	for (int i = 0; i < n; i++) {
+		obsData[i] = obs[i];
+	}
+	obsWindow = ObservationWindow(0, min(1, n), n);
+
+	// the kernels' exponents are of the old observations
+	for (int m = 0; m < NUM_PF_MODES; m++) {
+		kernels[m]->invalidate();
+	}
+
+	return true;
+}
+
+// reads one line of an observation file into obs, returns 0 for a blank
+// line, 1 for an observation, and -1 for anything else
+static
+int parseObservation(const string &line, Observation &obs) {
+	int id;
+	float d, b;
+	float rot1, trans, rot2;
+
+	int n = sscanf(line.c_str(), " %d , %f , %f , %f , %f , %f",
+				   &id, &d, &b, &rot1, &trans, &rot2);
+
+	if (n == EOF) {
+		return 0;
+	} else if (n == 3) {
+		obs = Observation(d, b, id);
+	} else if (n == 6) {
+		obs = Observation(d, b, id, Odometry(rot1, trans, rot2));
+	} else {
+		return -1;
+	}
+	return 1;
+}
+
+// loads the observation data from the given file
+bool ParticleFilter::loadObservations(const char *filename) {
 	int n = 0;
 	int i = 0;
-	int id;
-	char c;
-	float d;
-	float b;
+	string line;
+	Observation o(0.0f, 0.0f, 0);
 
 	ifstream fp_in(filename, ifstream::in);
 	if (!fp_in.is_open()) {
 		printf("could not open \"%s\"\n", filename);
-		exit(0);
+		return false;
 	}
 
 	// observation format:
 	// each line is in the following form
-	// id,x,y
+	// id,distance,bearing
+	// or, for a robot that moves, with the odometry since the last line
+	// id,distance,bearing,rot1,trans,rot2
 
 	// first pass: find out how many observations there are
-	while (fp_in >> id) {
-		fp_in >> c;		// chomp comma
-		fp_in >> d;
-		fp_in >> c;		// chomp comma
-		fp_in >> b;
-		n++;
+	for (int ln = 1; getline(fp_in, line); ln++) {
+		int r = parseObservation(line, o);
+		if (r < 0) {
+			printf("\"%s\" line %d: expected 3 or 6 values\n", filename, ln);
+			return false;
+		}
+		n += r;
 	}
-	obsData = (Observation *)malloc16(sizeof(Observation) * n);
-	obsWindow = ObservationWindow(0, 1, n);
+	Observation *obs = (Observation *)malloc16(sizeof(Observation) * max(n, 1));
+	dieIf(obs == NULL, "could not allocate the observations");
 
 	// second pass: instantiate each observation
 	fp_in.clear();		// must appear before seekg
 	fp_in.seekg(0);		// must appear after clear
-	while (fp_in >> id) {
-		fp_in >> c;		// chomp comma
-		fp_in >> d;
-		fp_in >> c;		// chomp comma
-		fp_in >> b;
-
-		checkRefObjIdRange(id);
-		obsData[i++] = Observation(d, b, id);
+	while (getline(fp_in, line)) {
+		if (parseObservation(line, o) > 0) {
+			obs[i++] = o;
+		}
 	}
 	fp_in.close();
 
-	printf("number of observations loaded: %d\n\n", i);
+	bool ok = setObservations(obs, i);
+	free16(obs);
+
+	if (ok) {
+		printf("number of observations loaded: %d\n\n", i);
+	}
+	return ok;
 }
 
+void ParticleFilter::predict(const Odometry &u) {
+	if (u.isZero()) {
+		return;
+	}
 
-Observation *getObservations() {
-	return obsData;
+	// every prediction draws different noise
+	getKernel(config.mode)->predict(u, mixSeed(config.seed, numDraws++));
 }
 
-ObservationWindow *getObservationWindow() {
-	return &obsWindow;
+bool ParticleFilter::resample() {
+	return getKernel(config.mode)->resample(config.resampleMethod, mixSeed(config.seed, numDraws++));
 }
 
-Rectangle getField() {
-	return FIELD;
-}
+bool ParticleFilter::resampleIfNeeded() {
+	float ess = getEffectiveSampleSize();
+	if (ess < 0.0f) {
+		return false;
+	}
 
-Rectangle getGrass() {
-	return GRASS;
-}
+	numEssChecks++;
+	if (ess >= config.resampleThreshold * getNumParticles() || !resample()) {
+		return false;
+	}
 
-RobotPose getActualPose() {
-	return RobotPose(ROBOT_POS, ROBOT_ANGLE, Point2D(0.0f, 0.0f), 0.0f);
+	numResamples++;
+	return true;
 }
 
-const Point2D *getReferenceObjects() {
-	return REF_OBJ_POS_ARR;
+float ParticleFilter::getEffectiveSampleSize() const {
+	return kernels[config.mode]->getEffectiveSampleSize();
 }
 
-int getNumReferenceObjects() {
-	return NUM_REF_OBJS;
+bool ParticleFilter::advance() {
+	int base = obsWindow.getBase();
+	obsWindow.next();
+	if (obsWindow.getBase() == base) {
+		return false;
+	}
+
+	// the weights of the last frame, before the particles move
+	resampleIfNeeded();
+
+	// the observation that joined the window
+	predict(obsData[obsWindow.getBase() + obsWindow.getSize() - 1].odom);
+	return true;
 }
 
-void togglePfMode() {
-	pfMode = (pfMode == PF_SSE) ? PF_SCALAR : PF_SSE;
+void ParticleFilter::toggleMode() {
+	config.mode = (PfMode)((config.mode + 1) % NUM_PF_MODES);
 }
 
-PfMode getPfMode() {
-	return pfMode;
+void ParticleFilter::setMode(PfMode mode) {
+	assert(mode >= 0 && mode < NUM_PF_MODES);
+	config.mode = mode;
 }
 
-const char *getPfModeString() {
-	assert(pfMode == PF_SCALAR || pfMode == PF_SSE);
-	return PF_MODE_STRINGS[pfMode];
+const char *ParticleFilter::getModeString() const {
+	assert(config.mode >= 0 && config.mode < NUM_PF_MODES);
+	return PF_MODE_STRINGS[config.mode];
 }
 
-RobotPose runPf() {
-	const char *mode;
+// the time spent in each stage is recorded in the profile zones,
+// see dumpProfileZones()
+RobotPose ParticleFilter::run() {
 	RobotPose pose;
 
 	Timer t;
 	t.start();
 
-	if (pfMode == PF_SSE) {
-		mode = "SSE   ";
-		pose = ssePf();
-	} else {
-		mode = "scalar";
-		pose = scalarPf();
-	}
+	pose = getKernel(config.mode)->run();
 
 	t.stop();
-	float sec = t.getElapsedSeconds();
-	pfFps = 1.0f / sec;		// saved to global state
-
-	if (pfFps < IDEAL_FPS) {
-		printf("\n%s inner loop exceeded time threshold: %f sec\n\n", mode, sec);
-	} else {
-		printf("%s inner loop: %f sec\n", mode, sec);
-	}
+	fps = 1.0f / t.getElapsedSeconds();
 
 	return pose;
 }
 
-float getLastPfFps() {
-	return pfFps;
+void ParticleFilter::runFrames(RobotPose *poses, int numFrames) {
+	if (numFrames <= 0) {
+		return;
+	}
+
+	ObservationWindow *windows = new ObservationWindow[numFrames];
+	for (int t = 0; t < numFrames; t++) {
+		windows[t] = obsWindow;
+		obsWindow.next();
+	}
+
+	Timer t;
+	t.start();
+
+	getKernel(config.mode)->runFrames(windows, poses, numFrames);
+
+	t.stop();
+	fps = numFrames / t.getElapsedSeconds();
+
+	delete[] windows;
 }
-
-ParticleArray getParticles() {
-	return ParticleArray(scalarParticles, scalarProb, NUM_SCALAR_PARTICLES);
+
+int ParticleFilter::getNumParticles() const {
+	// a mode that has not run yet starts with the configured number
+	int n = kernels[config.mode]->getNumParticles();
+	return (n > 0) ? n : config.numParticles;
 }
 
-ParticleArray_4Wide getParticles_4Wide() {
-	return ParticleArray_4Wide(sseParticles, sseProb, NUM_SSE_PARTICLES);
+Particle ParticleFilter::getParticle(int index) {
+	return getKernel(config.mode)->getParticle(index);
 }
 
-// runs both versions of the particle filter and compares their results
-void comparePfResults() {
+ProbabilityExponents ParticleFilter::getProbabilityExponents(int index) {
+	return getKernel(config.mode)->getProbabilityExponents(index);
+}
+
+// runs every version of the particle filter and compares their results
+// against the scalar version, then the two bearing models against each
+// other in the mode that was in use
+void ParticleFilter::compareModes() {
 	int numObs = obsWindow.getTotal();
 	obsWindow = ObservationWindow(0, min(5, numObs/2), numObs);
 
-	if (getPfMode() == PF_SSE) {
-		togglePfMode();
+	PfMode savedMode = getMode();
+
+	// compare whole windows rather than each mode's incremental updates
+	for (int m = 0; m < NUM_PF_MODES; m++) {
+		kernels[m]->invalidate();
 	}
 
-	RobotPose scalarPose = runPf();
-	togglePfMode();
-	RobotPose ssePose = runPf();
+	setMode(PF_SCALAR);
+	RobotPose scalarPose = run();
 
-	float totalDistDiff = 0.0f;
-	float totalBearDiff = 0.0f;
-	float maxDistDiff = 0.0f;
-	float maxBearDiff = 0.0f;
-	int numNans = 0;
+	printf("\n");
+	printf("scalar pose:\n");
+	scalarPose.println();
+	printf("\n");
 
-	// compare exponents of the similarity measures
-	int k = 0;		// index into standardArr
-	for (int i = 0; i < NUM_SSE_PARTICLES; i++) {		// index of the 4-wide
+	for (int m = PF_SCALAR + 1; m < NUM_PF_MODES; m++) {
+		setMode((PfMode)m);
+		RobotPose widePose = run();
 
-		ProbabilityExponents_4Wide sseArrElt = sseProb[i];
+		float totalDistDiff = 0.0f;
+		float totalBearDiff = 0.0f;
+		float maxDistDiff = 0.0f;
+		float maxBearDiff = 0.0f;
+		int numNans = 0;
 
-		for (int j = 0; j < SSE_WIDTH; j++)  {			// index into the current 4-wide
-			ProbabilityExponents a = scalarProb[k++];
-			ProbabilityExponents b = sseArrElt[j];
+		// compare exponents of the similarity measures, resampling may have
+		// left the modes with different numbers of particles
+		int n = min(getKernel(PF_SCALAR)->getNumParticles(), getKernel((PfMode)m)->getNumParticles());
+		for (int i = 0; i < n; i++) {
+			ProbabilityExponents a = getKernel(PF_SCALAR)->getProbabilityExponents(i);
+			ProbabilityExponents b = getKernel((PfMode)m)->getProbabilityExponents(i);
 
 			float distDiff = absDiff(a.distanceExp, b.distanceExp);
 			float bearDiff = absDiff(a.bearingExp, b.bearingExp);
@@ -643,33 +2331,114 @@ void comparePfResults() {
 			maxDistDiff = max(maxDistDiff, distDiff);
 			maxBearDiff = max(maxBearDiff, bearDiff);
 		}
+
+		printf("scalar vs %s comparison\n", PF_MODE_STRINGS[m]);
+		printf("------------------------\n");
+
+		// without split exponents the distance exponents are the sums
+		int numOk = n - numNans;
+		printf("per-particle similarity diff (in log-space):\n");
+		if (config.splitExponents) {
+			printf("maxDistDiff: %f, avgDistDiff: %f\n", maxDistDiff, totalDistDiff / numOk);
+			printf("maxBearDiff: %f, avgBearDiff: %f\n", maxBearDiff, totalBearDiff / numOk);
+		} else {
+			printf("maxSumDiff: %f, avgSumDiff: %f\n", maxDistDiff, totalDistDiff / numOk);
+		}
+		printf("\n");
+
+		if (numNans != 0) {
+			printf("implementation is really borked, found %d NaNs!!!\n\n", numNans);
+		}
+
+		printf("%s pose:\n", PF_MODE_STRINGS[m]);
+		widePose.println();
+		printf("\n");
+
+		printf("diff pose:\n");
+		(widePose - scalarPose).println();
+		printf("\n");
 	}
 
-	printf("\n");
-	printf("scalar vs sse comparison\n");
-	printf("------------------------\n");
-
-	int numOk = k - numNans;
-	printf("per-particle similarity diff (in log-space):\n");
-	printf("maxDistDiff: %f, avgDistDiff: %f\n", maxDistDiff, totalDistDiff / numOk);
-	printf("maxBearDiff: %f, avgBearDiff: %f\n", maxBearDiff, totalBearDiff / numOk);
-	printf("\n");
-
-	if (numNans != 0) {
-		printf("implementation is really borked, found %d NaNs!!!\n\n", numNans);
-	}
-
-	printf("scalar pose:\n");
-	scalarPose.println();
-	printf("\n");
-
-	printf("SSE pose:\n");
-	ssePose.println();
-	printf("\n");
-
-	printf("diff pose:\n");
-	(ssePose - scalarPose).println();
-	printf("\n");
+	// the vector bearings against the angles, on the same particles
+	setMode(savedMode);
+	PfKernel *kernel = getKernel(savedMode);
+	bool savedVectorBearings = config.vectorBearings;
+
+	config.vectorBearings = false;
+	kernel->invalidate();
+	RobotPose anglePose = run();
+	float angleEss = getEffectiveSampleSize();
+
+	int n = kernel->getNumParticles();
+	float *angleExps = new float[n];
+	for (int i = 0; i < n; i++) {
+		ProbabilityExponents e = kernel->getProbabilityExponents(i);
+		angleExps[i] = e.distanceExp + e.bearingExp;
+	}
+
+	config.vectorBearings = true;
+	kernel->invalidate();
+	RobotPose vectorPose = run();
+	float vectorEss = getEffectiveSampleSize();
+
+	float totalSumDiff = 0.0f;
+	float totalAngleExp = 0.0f;
+	float maxSumDiff = 0.0f;
+	int numNans = 0;
+
+	for (int i = 0; i < n; i++) {
+		ProbabilityExponents e = kernel->getProbabilityExponents(i);
+		float sumDiff = absDiff(angleExps[i], e.distanceExp + e.bearingExp);
+
+		if (isnan(sumDiff)) {
+			numNans++;
+			continue;
+		}
+
+		totalSumDiff += sumDiff;
+		totalAngleExp += fabsf(angleExps[i]);
+		maxSumDiff = max(maxSumDiff, sumDiff);
+	}
+	delete[] angleExps;
+
+	config.vectorBearings = savedVectorBearings;
+	kernel->invalidate();
+
+	printf("angle vs vector bearings comparison (%s)\n", PF_MODE_STRINGS[savedMode]);
+	printf("------------------------\n");
+
+	// the vector model gives large bearing errors a smaller penalty, so
+	// the diffs are largest for the particles that fit the worst
+	int numOk = n - numNans;
+	printf("per-particle similarity diff (in log-space):\n");
+	printf("maxSumDiff: %f, avgSumDiff: %f, avgAngleSum: %f\n",
+		   maxSumDiff, totalSumDiff / numOk, totalAngleExp / numOk);
+	printf("effective sample size: %f angle, %f vector\n", angleEss, vectorEss);
+	printf("\n");
+
+	if (numNans != 0) {
+		printf("implementation is really borked, found %d NaNs!!!\n\n", numNans);
+	}
+
+	printf("angle pose:\n");
+	anglePose.println();
+	printf("\n");
+
+	printf("vector pose:\n");
+	vectorPose.println();
+	printf("\n");
+
+	printf("diff pose:\n");
+	(vectorPose - anglePose).println();
+	printf("\n");
+
+	dumpProfileZones(stdout);
+	printf("\n");
+
+	if (perfCountersActive()) {
+		dumpPerfRegions(stdout);
+		printf("\n");
+	}
 }
 
 
@@ -3,29 +3,62 @@
 // interface to the particle filter
 
 #include "sys/common.h"
+#include "sys/ThreadPool.h"
 
 #include "sse/sse.h"
 
+#include "Lanes.h"
 #include "Particle.h"
-#include "Particle_4Wide.h"
 
 
 // operating modes for the particle filter
 enum PfMode {
 	PF_SCALAR,	// scalar-based particle filter
-	PF_SSE		// SSE-based particle filter
+	PF_SSE,		// SSE-based particle filter
+	PF_SSE8,	// SSE-based, 8 particles per step in 2 registers
+	PF_SSE16,	// SSE-based, 16 particles per step in 4 registers
+	NUM_PF_MODES
 };
 
+// ways of drawing the particles when resampling, both split the total
+// weight into n equal strata and draw one particle from each
+enum ResampleMethod {
+	RESAMPLE_SYSTEMATIC,	// the same offset into every stratum, from one uniform
+	RESAMPLE_STRATIFIED		// an offset of its own into each stratum
+};
+
+
+// the motion of the robot between two observations, in the rotate,
+// translate, rotate form: it turns by rot1 to face its new position,
+// moves trans straight to it, then turns by rot2 to its new heading
+class Odometry {
+public:
+	AngRad rot1;
+	float trans;
+	AngRad rot2;
+
+	forceinline Odometry()
+		: rot1(0.0f), trans(0.0f), rot2(0.0f) {}
+
+	forceinline Odometry(AngRad in_rot1, float in_trans, AngRad in_rot2)
+		: rot1(in_rot1), trans(in_trans), rot2(in_rot2) {}
+
+	bool isZero() const {
+		return rot1 == 0.0f && trans == 0.0f && rot2 == 0.0f;
+	}
+};
 
-// distance, bearing, and id
+// distance, bearing, and id, with the motion since the last observation
 class Observation {
 public:
 	float d;		// distance
 	AngRad b;		// bearing
 	int id;			// reference object ID
+	Odometry odom;	// zero for a robot that stands still
 
-	forceinline Observation(float in_d, AngRad in_b, int in_id)
-		: d(in_d), b(in_b), id(in_id) {}
+	forceinline Observation(float in_d, AngRad in_b, int in_id,
+							const Odometry &in_odom = Odometry())
+		: d(in_d), b(in_b), id(in_id), odom(in_odom) {}
 };
 
 // the observations to use, in the form of base and size
@@ -108,181 +141,296 @@ public:
 	}
 };
 
-// a pair of exponents, one for distance similarity and one for bearing similarity
-class ProbabilityExponents {
+// pairs of exponents, one for distance similarity and one for bearing similarity,
+// F is any lane type (see Lanes.h)
+template <class F>
+class ProbabilityExponents_Wide {
+private:
+	typedef Lanes<F> L;
+
 public:
-	float distanceExp;
-	float bearingExp;
+	F distanceExp;
+	F bearingExp;
 
-	forceinline ProbabilityExponents() {}
+	forceinline ProbabilityExponents_Wide() {}
 
-	forceinline ProbabilityExponents(float in_distanceExp, float in_bearingExp)
+	forceinline ProbabilityExponents_Wide(F in_distanceExp, F in_bearingExp)
 		: distanceExp(in_distanceExp), bearingExp(in_bearingExp) {}
 
-	forceinline ProbabilityExponents operator +
-							(const ProbabilityExponents &rhs) const
+	// extract an element from the wide
+	forceinline ProbabilityExponents_Wide<float> operator [](int index) const {
+		return ProbabilityExponents_Wide<float>(L::get(distanceExp, index),
+												L::get(bearingExp, index));
+	}
+
+	forceinline ProbabilityExponents_Wide operator +
+							(const ProbabilityExponents_Wide &rhs) const
 	{
-		return ProbabilityExponents(distanceExp + rhs.distanceExp,
-									bearingExp  + rhs.bearingExp);
+		return ProbabilityExponents_Wide(distanceExp + rhs.distanceExp,
+										 bearingExp  + rhs.bearingExp);
 	}
 
-	forceinline ProbabilityExponents &operator +=
-							(const ProbabilityExponents &rhs)
+	forceinline ProbabilityExponents_Wide &operator +=
+							(const ProbabilityExponents_Wide &rhs)
 	{
 		operator =(operator +(rhs)); return *this;
 	}
 
 	void println() const {
-		printf("d: % f, b: % f\n", distanceExp, bearingExp);
+		for (int i = 0; i < L::WIDTH; i++) {
+			printf("d: % f, b: % f\n", L::get(distanceExp, i), L::get(bearingExp, i));
+		}
 	}
 };
 
+typedef ProbabilityExponents_Wide<float> ProbabilityExponents;
+
 
 // different helper methods for extracting items from ProbabilityExponents
 
+template <class F>
 static forceinline
-float getDistanceExponent(const ProbabilityExponents &pe) {
+F getDistanceExponent(const ProbabilityExponents_Wide<F> &pe) {
 	return pe.distanceExp;
 }
 
+template <class F>
 static forceinline
-float getBearingExponent(const ProbabilityExponents &pe) {
+F getBearingExponent(const ProbabilityExponents_Wide<F> &pe) {
 	return pe.bearingExp;
 }
 
+template <class F>
 static forceinline
-float getDistancePlusBearingExponent(const ProbabilityExponents &pe) {
+F getDistancePlusBearingExponent(const ProbabilityExponents_Wide<F> &pe) {
 	return pe.distanceExp + pe.bearingExp;
 }
 
 
-class ProbabilityExponents_4Wide {
-public:
-	sse4Floats distanceExp;
-	sse4Floats bearingExp;
+//--- EXTERNAL INTERFACE---//
 
-	forceinline ProbabilityExponents_4Wide() {}
+// particle counts are clamped to [1, MAX_NUM_PARTICLES] and need
+// not be a multiple of any lane width
+static const int DEFAULT_NUM_PARTICLES = 16384;
+static const int MAX_NUM_PARTICLES     = 16 * 1024 * 1024;
 
-	forceinline ProbabilityExponents_4Wide(sse4Floats in_distanceExp,
-											 sse4Floats in_bearingExp)
-		: distanceExp(in_distanceExp), bearingExp(in_bearingExp) {}
+// names of the modes, in the order of PfMode
+extern const char *PF_MODE_STRINGS[];
 
-	// extract an element from the 4-wide
-	forceinline ProbabilityExponents operator [](int index) const {
-		return ProbabilityExponents(distanceExp[index], bearingExp[index]);
-	}
 
-	forceinline ProbabilityExponents_4Wide operator +
-							(const ProbabilityExponents_4Wide &rhs) const
-	{
-		return ProbabilityExponents_4Wide(distanceExp + rhs.distanceExp,
-										  bearingExp  + rhs.bearingExp);
-	}
+// the field the robot is on and the landmarks it observes
+class FieldMap {
+public:
+	Rectangle field;			// in-bounds area of the field
+	Rectangle grass;			// where the robot can be, slightly larger than the field
+	const Point2D *refObjs;		// reference objects, indexed by Observation::id
+	int numRefObjs;
+
+	forceinline FieldMap(Rectangle in_field, Rectangle in_grass,
+						 const Point2D *in_refObjs, int in_numRefObjs)
+		: field(in_field), grass(in_grass),
+		  refObjs(in_refObjs), numRefObjs(in_numRefObjs) {}
+};
 
-	forceinline ProbabilityExponents_4Wide &operator +=
-							(const ProbabilityExponents_4Wide &rhs)
-	{
-		operator =(operator +(rhs)); return *this;
-	}
+// the field of the observation generator
+const FieldMap &getDefaultFieldMap();
 
-	void println() const {
-		operator [](0).println();
-		operator [](1).println();
-		operator [](2).println();
-		operator [](3).println();
-	}
+// the robot pose the observations were generated from
+RobotPose getActualPose();
+
+
+// settings of a particle filter, the defaults match the observation generator
+class PfConfig {
+public:
+	int numParticles;			// every mode starts with this many
+	PfMode mode;
+	unsigned int seed;			// for placing the particles
+	int numThreads;				// to run on, 0 means one per processor
+
+	// estimate the pose in the same pass as the last observation,
+	// ang_sd is then the circular standard deviation
+	bool fusedPose;
+
+	// frames between weighing the whole window, 0 for every frame
+	int recomputeFrames;
+
+	bool vectorBearings;		// compare the bearings as unit vectors
+	bool splitExponents;		// keep the distance exponents apart
+
+	// how far below the best a particle drops out of a frame, 0 never
+	float pruneExponent;
+
+	// standard deviations of the observations
+	float distSigma;			// relative to the distance
+	AngRad bearSigma;			// relative to PI
+
+	// noise of the odometry motion model, per unit squared of the motion
+	float rotRotNoise;			// rad^2 per rad^2
+	float rotTransNoise;		// rad^2 per mm^2
+	float transTransNoise;		// mm^2 per mm^2
+	float transRotNoise;		// mm^2 per rad^2
+
+	ResampleMethod resampleMethod;
+
+	// the fraction of the particles the effective sample size must fall
+	// below for advance() to resample, 0 never
+	float resampleThreshold;
+
+	// KLD-sampling's bound on the KL divergence of the drawn particles,
+	// 0 keeps the number of particles
+	float kldError;
+	float kldQuantile;			// 2.326 is 99%
+	float kldBinSize;			// the bins' sides, in mm
+	AngRad kldBinAngle;			// and their angles
+	int minParticles;			// the bounds on the number drawn
+	int maxParticles;
+
+	PfConfig()
+		: numParticles(DEFAULT_NUM_PARTICLES), mode(PF_SSE), seed(1), numThreads(0),
+		  fusedPose(false), recomputeFrames(32),
+		  vectorBearings(false), splitExponents(false), pruneExponent(0.0f), distSigma(0.2f), bearSigma(0.05f),
+		  rotRotNoise(0.01f), rotTransNoise(1e-7f),
+		  transTransNoise(0.01f), transRotNoise(100.0f),
+		  resampleMethod(RESAMPLE_SYSTEMATIC), resampleThreshold(0.5f),
+		  kldError(0.0f), kldQuantile(2.326f), kldBinSize(500.0f), kldBinAngle(M_PI / 9.0f),
+		  minParticles(256), maxParticles(65536) {}
 };
 
 
-// different helper methods for extracting items from ProbabilityExponents4Wide
+class PfKernel;		// see pf.cpp
 
-static forceinline
-sse4Floats getDistanceExponent(const ProbabilityExponents_4Wide &pe) {
-	return pe.distanceExp;
-}
+// a particle filter with its own particles, observations, map and settings,
+// separate filters can run on different threads once each calls SSE::init()
+class ParticleFilter {
+private:
+	// instance variables
+	FieldMap map;
+	PfConfig config;
 
-static forceinline
-sse4Floats getBearingExponent(const ProbabilityExponents_4Wide&pe) {
-	return pe.bearingExp;
-}
+	Observation *obsData;			// 16-byte aligned
+	ObservationWindow obsWindow;
 
-static forceinline
-sse4Floats getDistancePlusBearingExponent(const ProbabilityExponents_4Wide &pe) {
-	return pe.distanceExp + pe.bearingExp;
-}
+	Particle *initialParticles;		// every mode starts from these
+	RandGen rng;
 
+	float fps;						// last invocation's frames per second
+	unsigned int numDraws;			// seeds the next predict() or resample()
 
-// all scalar particles and associated data
-class ParticleArray {
-public:
-	Particle *p;
-	ProbabilityExponents *e;
-	int n;
+	int numEssChecks;				// calls to resampleIfNeeded() that could tell
+	int numResamples;				// of those, the ones that resampled
+
+	PfKernel *kernels[NUM_PF_MODES];
 
-	forceinline ParticleArray() {}
+	// mutable since running the workers does not change the filter
+	mutable ThreadPool pool;
 
-	forceinline ParticleArray(Particle *in_p,
-								ProbabilityExponents *in_e,
-								int in_n)
-		: p(in_p), e(in_e), n(in_n) {}
-};
+	// not copyable, owns the particles and observations
+	ParticleFilter(const ParticleFilter &rhs);
+	ParticleFilter &operator =(const ParticleFilter &rhs);
+
+	PfKernel *getKernel(PfMode mode);
 
-// all SSE particles and associated data
-class ParticleArray_4Wide {
 public:
-	Particle_4Wide *p;
-	ProbabilityExponents_4Wide *e;
-	int n;		// number of 4-wides
+	ParticleFilter(const PfConfig &in_config = PfConfig(),
+				   const FieldMap &in_map = getDefaultFieldMap());
 
-	forceinline ParticleArray_4Wide() {}
+	~ParticleFilter();
 
-	forceinline ParticleArray_4Wide(Particle_4Wide *in_p,
-									  ProbabilityExponents_4Wide *in_e,
-									  int in_n)
-		: p(in_p), e(in_e), n(in_n) {}
-};
+	// places n particles randomly on the grass, every mode starts from them
+	void initParticles(int n);
 
+	// copies in n observations and shows the first one, returns false
+	// if one refers to a reference object that is not on the map
+	bool setObservations(const Observation *obs, int n);
 
-//--- EXTERNAL INTERFACE---//
+	// loads the observations from a file, see setObservations()
+	bool loadObservations(const char *filename);
 
-void seedParticleGen(unsigned int rand_seed);
+	// moves the particles of the current mode by the odometry, with noise,
+	// later frames only weigh them against observations that join the window
+	void predict(const Odometry &u);
 
-void initAllParticles();
+	// moves the window to the next observation and the particles by its
+	// odometry, returns false if the window is already at the end
+	bool advance();
 
+	// draws the particles of the current mode again by their weights,
+	// returns false and leaves them if they all weigh nothing
+	bool resample();
 
-void loadObservationData(const char *filename);
+	// resamples if the effective sample size is below
+	// PfConfig::resampleThreshold, returns true if it did
+	bool resampleIfNeeded();
 
-Observation *getObservations();
+	// (sum w)^2 / sum w^2 of the last frame, -1 if the particles changed since
+	float getEffectiveSampleSize() const;
 
-ObservationWindow *getObservationWindow();
-
+	// the fraction of the calls to resampleIfNeeded() that resampled,
+	// leaving out those that could not tell
+	float getResampleRate() const {
+		return (numEssChecks > 0) ? (float)numResamples / numEssChecks : 0.0f;
+	}
 
-Rectangle getField();
+	const Observation *getObservations() const {
+		return obsData;
+	}
 
-Rectangle getGrass();
+	ObservationWindow &getObservationWindow() {
+		return obsWindow;
+	}
 
-RobotPose getActualPose();
+	const ObservationWindow &getObservationWindow() const {
+		return obsWindow;
+	}
+
+	const FieldMap &getMap() const {
+		return map;
+	}
+
+	const PfConfig &getConfig() const {
+		return config;
+	}
 
-const Point2D *getReferenceObjects();
+	ThreadPool &getThreadPool() const {
+		return pool;
+	}
 
-int getNumReferenceObjects();
+	// cycles through the modes
+	void toggleMode();
 
+	void setMode(PfMode mode);
 
-void togglePfMode();
+	PfMode getMode() const {
+		return config.mode;
+	}
 
-PfMode getPfMode();
+	const char *getModeString() const;
 
-const char *getPfModeString();
+	RobotPose run();
 
-RobotPose runPf();
-
-float getLastPfFps();
+	// like calling run() and next() numFrames times, with the frames
+	// overlapping on the threads
+	void runFrames(RobotPose *poses, int numFrames);
 
-ParticleArray getParticles();
+	float getLastFps() const {
+		return fps;
+	}
+
+	// the particles of the current mode, one at a time, resample() can
+	// change how many there are
+	int getNumParticles() const;
 
-ParticleArray_4Wide getParticles_4Wide();
+	Particle getParticle(int index);
 
-void comparePfResults();
+	// the exponents of particle index of the last frame, without
+	// PfConfig::splitExponents the distance exponent is their sum and
+	// the bearing exponent is 0
+	ProbabilityExponents getProbabilityExponents(int index);
+
+	// compares every mode against the scalar mode, and the vector
+	// bearings against the angles
+	void compareModes();
+};
 
 
 // end of pf.h
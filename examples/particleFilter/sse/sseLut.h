@@ -0,0 +1,293 @@
+#pragma once
+
+// table-based versions of functions in sseMath.h, the tables are built at
+// startup and looked up with linear or quadratic interpolation
+//
+// compile with -mavx2 to use the AVX2 gather instructions, otherwise the
+// gathers are emulated with SSE2
+
+#include <math.h>
+
+#include "sys/common.h"
+#include "sys/mem.h"
+
+#include "sse/sseMath.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+
+//--- GATHER ---//
+
+// 4-wide gather, element i of the result is base[idx[i]]
+static forceinline
+sse4Floats gather4(const float *base, sse4Ints idx) {
+#ifdef __AVX2__
+	return _mm_i32gather_ps(base, idx.data, sizeof(float));
+#else
+	int i0 = _mm_cvtsi128_si32(idx.data);
+	int i1 = _mm_cvtsi128_si32(_mm_shuffle_epi32(idx.data, _MM_SHUFFLE(1, 1, 1, 1)));
+	int i2 = _mm_cvtsi128_si32(_mm_shuffle_epi32(idx.data, _MM_SHUFFLE(2, 2, 2, 2)));
+	int i3 = _mm_cvtsi128_si32(_mm_shuffle_epi32(idx.data, _MM_SHUFFLE(3, 3, 3, 3)));
+
+	return sse4Floats(base[i0], base[i1], base[i2], base[i3]);
+#endif
+}
+
+
+//--- LOOKUP TABLE ---//
+
+// the different ways to interpolate between table entries
+enum LutInterp {
+	LUT_LINEAR,		// 2 gathers per lookup
+	LUT_QUADRATIC	// 3 gathers per lookup
+};
+
+// samples of a function on [lo, hi], split into n equal segments,
+// each segment stores the coefficients of a polynomial in t, where t
+// is the position within the segment on [0, 1)
+class sseLut {
+private:
+	float *c0;		// constant coefficients
+	float *c1;		// linear coefficients
+	float *c2;		// quadratic coefficients, unused for LUT_LINEAR
+	int n;			// number of segments
+	float lo;		// start of the domain
+	float scale;	// segments per unit of input
+	LutInterp interp;
+
+	// not copyable, the coefficient arrays are owned
+	sseLut(const sseLut &rhs);
+	sseLut &operator =(const sseLut &rhs);
+
+	void release() {
+		if (c0 != NULL) {
+			free16(c0);
+			free16(c1);
+			free16(c2);
+		}
+		c0 = c1 = c2 = NULL;
+	}
+
+public:
+	sseLut()
+		: c0(NULL), c1(NULL), c2(NULL), n(0), lo(0.0f), scale(0.0f),
+		  interp(LUT_LINEAR) {}
+
+	~sseLut() {
+		release();
+	}
+
+	// samples func at n + 1 evenly spaced points on [in_lo, in_hi] (and at the
+	// segment midpoints for LUT_QUADRATIC), the samples are taken in double
+	// precision so that the table does not add its own rounding error
+	void init(double (*func)(double), float in_lo, float in_hi,
+			  int in_n, LutInterp in_interp)
+	{
+		assert(in_n > 0 && in_lo < in_hi);
+
+		release();
+		n = in_n;
+		lo = in_lo;
+		scale = n / (in_hi - in_lo);
+		interp = in_interp;
+
+		// one extra entry so that lookups at exactly hi are in bounds
+		size_t size = sizeof(float) * (n + 1);
+		c0 = (float *)malloc16(size);
+		c1 = (float *)malloc16(size);
+		c2 = (float *)malloc16(size);
+
+		double h = ((double)in_hi - in_lo) / n;
+		for (int i = 0; i <= n; i++) {
+			double x0 = in_lo + h * i;
+			double f0 = func(x0);
+			double f1 = func(x0 + h);
+
+			if (interp == LUT_LINEAR) {
+				c0[i] = (float)f0;
+				c1[i] = (float)(f1 - f0);
+				c2[i] = 0.0f;
+			} else {
+				// the parabola through t = 0, 0.5, and 1
+				double fm = func(x0 + 0.5 * h);
+				c0[i] = (float)f0;
+				c1[i] = (float)(4.0 * fm - 3.0 * f0 - f1);
+				c2[i] = (float)(2.0 * (f0 + f1) - 4.0 * fm);
+			}
+		}
+	}
+
+	forceinline bool isInit() const {
+		return c0 != NULL;
+	}
+
+	forceinline int getNumSegments() const {
+		return n;
+	}
+
+	forceinline LutInterp getInterp() const {
+		return interp;
+	}
+
+	// 4-wide lookup, input outside of [lo, hi] is extrapolated
+	// from the first or last segment
+	forceinline sse4Floats lookup(sse4Floats x) const {
+		assert(isInit());
+
+		sse4Floats pos = (x - sse4Floats::expand(lo)) * sse4Floats::expand(scale);
+		sse4Ints idx = min4(max4(cast_f2i(pos), sse4Ints::zeros()),
+							sse4Ints::expand(n - 1));
+		sse4Floats t = pos - cast_i2f(idx);
+
+		sse4Floats a = gather4(c0, idx);
+		sse4Floats b = gather4(c1, idx);
+
+		if (interp == LUT_LINEAR) {
+			return a + t*b;
+		}
+
+		sse4Floats c = gather4(c2, idx);
+		return a + t*(b + t*c);
+	}
+
+	// 1-wide lookup, same behavior as the 4-wide version
+	forceinline float lookup(float x) const {
+		assert(isInit());
+
+		float pos = (x - lo) * scale;
+		int i = clamp((int)pos, 0, n - 1);
+		float t = pos - i;
+
+		return c0[i] + t*(c1[i] + t*c2[i]);
+	}
+
+	// looks up count values from in and writes them to out, neither array
+	// needs to be aligned, this is the entry point for the AVX2 8-wide gather
+	void lookup_array(const float *in, float *out, int count) const {
+		assert(isInit());
+
+		int i = 0;
+
+#ifdef __AVX2__
+		__m256 lo8    = _mm256_set1_ps(lo);
+		__m256 scale8 = _mm256_set1_ps(scale);
+		__m256i zero8 = _mm256_setzero_si256();
+		__m256i last8 = _mm256_set1_epi32(n - 1);
+
+		for (; i + 8 <= count; i += 8) {
+			__m256 pos = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(in + i), lo8),
+									   scale8);
+			__m256i idx = _mm256_min_epi32(_mm256_max_epi32(_mm256_cvttps_epi32(pos),
+															zero8), last8);
+			__m256 t = _mm256_sub_ps(pos, _mm256_cvtepi32_ps(idx));
+
+			__m256 a = _mm256_i32gather_ps(c0, idx, sizeof(float));
+			__m256 b = _mm256_i32gather_ps(c1, idx, sizeof(float));
+			__m256 res;
+
+			if (interp == LUT_LINEAR) {
+				res = _mm256_add_ps(a, _mm256_mul_ps(t, b));
+			} else {
+				__m256 c = _mm256_i32gather_ps(c2, idx, sizeof(float));
+				res = _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_add_ps(b, _mm256_mul_ps(t, c))));
+			}
+
+			_mm256_storeu_ps(out + i, res);
+		}
+#endif
+
+		for (; i + SSE_WIDTH <= count; i += SSE_WIDTH) {
+			sse4Floats res = lookup(sse4Floats(_mm_loadu_ps(in + i)));
+			_mm_storeu_ps(out + i, res.data);
+		}
+
+		for (; i < count; i++) {
+			out[i] = lookup(in[i]);
+		}
+	}
+};
+
+
+//--- EXP ---//
+
+static forceinline
+double __exp_lut_func(double x) {
+	return ::exp(x);
+}
+
+// builds the table used by exp_lut(), n is the number of segments
+// covering [0, log_e(2)]
+static forceinline
+void initExpLut(sseLut &lut, int n, LutInterp interp) {
+	lut.init(__exp_lut_func, 0.0f, 0.693147f, n, interp);
+}
+
+// table-based version of exp(), the input is split into a power of 2
+// and a remainder on [0, log_e(2)), which is looked up in the table
+//
+// NOTE: the input is clamped to the same range as exp()
+static forceinline
+sse4Floats exp_lut(const sseLut &lut, sse4Floats x) {
+	sse4Floats min_thr = reint_i2f(sse4Ints::expand(0xc2aeac51));	// -87.336555f
+	sse4Floats max_thr = reint_i2f(sse4Ints::expand(0x42b0c0a6));	//  88.376266f
+	sse4Floats log_2e  = reint_i2f(sse4Ints::expand(0x3fb8aa3b));	//  1.442695f
+
+	// log_e(2) split in two, so that k * ln2_hi is exact
+	sse4Floats ln2_hi = reint_i2f(sse4Ints::expand(0x3f317000));	// 0.693115f
+	sse4Floats ln2_lo = reint_i2f(sse4Ints::expand(0x3805fdf4));	// 0.000032f
+
+	sse4Floats xc = min4(max_thr, max4(min_thr, x));
+
+	sse4Floats k = floor(log_2e*xc);
+	sse4Floats r = (xc - k*ln2_hi) - k*ln2_lo;
+
+	return __exp_exponent(cast_f2i(k)) * lut.lookup(r);
+}
+
+
+//--- ATAN ---//
+
+static forceinline
+double __atan_lut_func(double x) {
+	return ::atan(x);
+}
+
+// builds the table used by atan_lut(), n is the number of segments
+// covering [0, 1]
+static forceinline
+void initAtanLut(sseLut &lut, int n, LutInterp interp) {
+	lut.init(__atan_lut_func, 0.0f, 1.0f, n, interp);
+}
+
+// table-based version of atan(), uses the same identities as atan()
+// to bring all input into [0, 1], which is looked up in the table
+static forceinline
+sse4Floats atan_lut(const sseLut &lut, sse4Floats x) {
+	sse4Floats one     = reint_i2f(sse4Ints::expand(0x3f800000));	// 1.0f
+	sse4Floats half_pi = reint_i2f(sse4Ints::expand(0x3fc90fdb));	// 1.570796f
+
+	// atan(x) = -atan(-x)
+	sseMask    neg_x = x < sse4Floats::zeros();
+	sse4Floats abs_x = abs(x);
+
+	// atan(x) = PI/2 - atan(1/x), a full division is used since the
+	// error of approx_rcp() would swamp the error of the table
+	sseMask    inv_mask = (abs_x > one);
+	sse4Floats x_ror = blend4(inv_mask, one / abs_x, abs_x);
+
+	sse4Floats atan_rd = lut.lookup(x_ror);
+
+	// the first segment loses the relative precision of small input,
+	// below this cutoff x and atan(x) are identical
+	sse4Floats thr = reint_i2f(sse4Ints::expand(0x39800000));	// 0.000244f
+	atan_rd = blend4(x_ror < thr, x_ror, atan_rd);
+
+	sse4Floats range_fixed = blend4(inv_mask, half_pi - atan_rd, atan_rd);
+
+	return blend4(neg_x, -range_fixed, range_fixed);
+}
+
+
+// end of sseLut.h
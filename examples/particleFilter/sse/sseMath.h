@@ -13,6 +13,14 @@
 // 4-wide cast from float to int, i.e. truncation
 static forceinline
 sse4Ints cast_f2i(sse4Floats input) {
+	return sse4Ints(_mm_cvttps_epi32(input.data));
+}
+
+
+// 4-wide conversion from float to int using the current rounding mode,
+// SSE::init() sets this to round-to-nearest
+static forceinline
+sse4Ints round_f2i(sse4Floats input) {
 	return sse4Ints(_mm_cvtps_epi32(input.data));
 }
 
@@ -132,6 +140,233 @@ sse4Floats abs_ref(sse4Floats x) {
 					  fabsf(x[1]),
 					  fabsf(x[2]),
 					  fabsf(x[3]));
+}
+
+
+//--- TRUNC ---//
+
+// returns only the sign bits of x, all other bits are cleared
+static forceinline
+sse4Floats __sign_bits(sse4Floats x) {
+	sse4Floats sign_bit = reint_i2f(sse4Ints::expand(0x80000000));
+	return x & sign_bit;
+}
+
+
+// fast version
+//
+// every float with a magnitude of at least 2^23 is already an integer, so
+// those values (along with INF and NaN) are passed through unchanged,
+// everything else goes through the truncating conversion to int and back
+static forceinline
+sse4Floats trunc(sse4Floats x) {
+	sse4Floats two_23 = reint_i2f(sse4Ints::expand(0x4b000000));	// 8388608.0f
+
+	// restore the sign bit so that, e.g., trunc(-0.5f) is -0.0f
+	sse4Floats t = cast_i2f(cast_f2i(x)) | __sign_bits(x);
+
+	return blend4(abs(x) < two_23, t, x);
+}
+
+
+// reference version
+static forceinline
+sse4Floats trunc_ref(sse4Floats x) {
+	return sse4Floats(truncf(x[0]),
+					  truncf(x[1]),
+					  truncf(x[2]),
+					  truncf(x[3]));
+}
+
+
+//--- FLOOR ---//
+
+// fast version
+static forceinline
+sse4Floats floor(sse4Floats x) {
+	sse4Floats one = reint_i2f(sse4Ints::expand(0x3f800000));	// 1.0f
+
+	// truncation rounds toward zero, so step down wherever that went up
+	sse4Floats t = trunc(x);
+	return t - blend4(t > x, one, sse4Floats::zeros());
+}
+
+
+// reference version
+static forceinline
+sse4Floats floor_ref(sse4Floats x) {
+	return sse4Floats(floorf(x[0]),
+					  floorf(x[1]),
+					  floorf(x[2]),
+					  floorf(x[3]));
+}
+
+
+//--- CEIL ---//
+
+// fast version
+static forceinline
+sse4Floats ceil(sse4Floats x) {
+	sse4Floats one = reint_i2f(sse4Ints::expand(0x3f800000));	// 1.0f
+
+	// truncation rounds toward zero, so step up wherever that went down,
+	// the sign bit is restored so that, e.g., ceil(-0.5f) is -0.0f
+	sse4Floats t = trunc(x);
+	return (t + blend4(t < x, one, sse4Floats::zeros())) | __sign_bits(x);
+}
+
+
+// reference version
+static forceinline
+sse4Floats ceil_ref(sse4Floats x) {
+	return sse4Floats(ceilf(x[0]),
+					  ceilf(x[1]),
+					  ceilf(x[2]),
+					  ceilf(x[3]));
+}
+
+
+//--- ROUND ---//
+
+// fast version, halfway cases are rounded away from zero
+static forceinline
+sse4Floats round(sse4Floats x) {
+	sse4Floats half = reint_i2f(sse4Ints::expand(0x3f000000));	// 0.5f
+	sse4Floats one  = reint_i2f(sse4Ints::expand(0x3f800000));	// 1.0f
+
+	// the fractional part x - trunc(x) is exact, so comparing it against
+	// 0.5f does not suffer from the rounding error of trunc(x + 0.5f)
+	sse4Floats t = trunc(x);
+	sse4Floats away = blend4(abs(x - t) >= half,
+							 one | __sign_bits(x), sse4Floats::zeros());
+
+	// the sign bit is restored so that, e.g., round(-0.25f) is -0.0f
+	return (t + away) | __sign_bits(x);
+}
+
+
+// reference version
+static forceinline
+sse4Floats round_ref(sse4Floats x) {
+	return sse4Floats(roundf(x[0]),
+					  roundf(x[1]),
+					  roundf(x[2]),
+					  roundf(x[3]));
+}
+
+
+//--- FMOD ---//
+
+// x - q*y for two lanes in double precision, where q is the quotient
+// truncated in single precision, the product of q's and y's 24 bits is
+// exact in a double and so is the difference, which leaves only the
+// quotient being off by one to correct
+static forceinline
+__m128d __fmod_pd(__m128d x, __m128d y, __m128d q) {
+	__m128d sign_bit = _mm_set1_pd(-0.0);
+	__m128d abs_y = _mm_andnot_pd(sign_bit, y);
+	__m128d step  = _mm_or_pd(abs_y, _mm_and_pd(sign_bit, x));	// |y| with the sign of x
+
+	__m128d r = _mm_sub_pd(x, _mm_mul_pd(q, y));
+
+	// the rounded quotient can be off by one in either direction, so
+	// pull r back toward zero or push it back across zero as needed
+	__m128d over = _mm_cmpge_pd(_mm_andnot_pd(sign_bit, r), abs_y);
+	r = _mm_sub_pd(r, _mm_and_pd(over, step));
+	__m128d flipped = _mm_cmplt_pd(_mm_mul_pd(r, x), _mm_setzero_pd());
+	return _mm_add_pd(r, _mm_and_pd(flipped, step));
+}
+
+
+// fast version, the result has the same sign as x and a magnitude less
+// than the magnitude of y, and matches fmodf exactly for |x / y| below 2^24
+//
+// NOTE: the quotient is truncated in single precision, so past |x / y| of
+// 2^24 it can be off by more than one and the result by a multiple of y,
+// and once x / y overflows the result is an infinity with the sign of x
+static forceinline
+sse4Floats fmod(sse4Floats x, sse4Floats y) {
+	sse4Floats q = trunc(x / y);
+
+	__m128d lo = __fmod_pd(_mm_cvtps_pd(x.data), _mm_cvtps_pd(y.data),
+						   _mm_cvtps_pd(q.data));
+	__m128d hi = __fmod_pd(_mm_cvtps_pd(_mm_movehl_ps(x.data, x.data)),
+						   _mm_cvtps_pd(_mm_movehl_ps(y.data, y.data)),
+						   _mm_cvtps_pd(_mm_movehl_ps(q.data, q.data)));
+	sse4Floats r = _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi));
+
+	// a zero remainder keeps the sign of x, and a finite x is its own
+	// remainder by an infinite y, where q*y above is NaN
+	sse4Floats inf = reint_i2f(sse4Ints::expand(0x7f800000));
+	r = abs(r) | __sign_bits(x);
+	return blend4((abs(y) == inf) & (abs(x) < inf), x, r);
+}
+
+
+// reference version
+static forceinline
+sse4Floats fmod_ref(sse4Floats x, sse4Floats y) {
+	return sse4Floats(fmodf(x[0], y[0]),
+					  fmodf(x[1], y[1]),
+					  fmodf(x[2], y[2]),
+					  fmodf(x[3], y[3]));
+}
+
+
+//--- ANGLE WRAPPING ---//
+
+// subtracts k multiples of PI from x, where k must be integral,
+// PI is split into three parts (Cody-Waite) so that the products
+// with the leading parts are exact and little precision is lost
+static forceinline
+sse4Floats __sub_pi_multiple(sse4Floats x, sse4Floats k) {
+	sse4Floats c1 = reint_i2f(sse4Ints::expand(0x40490000));	// 3.140625f
+	sse4Floats c2 = reint_i2f(sse4Ints::expand(0x3a7da000));	// 0.000968f
+	sse4Floats c3 = reint_i2f(sse4Ints::expand(0x34222169));	// 1.509958e-07f
+
+	return ((x - k*c1) - k*c2) - k*c3;
+}
+
+
+// fast version, takes any finite angle in radians and
+// returns the equivalent angle on [-PI, PI]
+//
+// all lanes take the same path, so the running time does not depend on
+// how many turns away from [-PI, PI] the input is
+//
+// NOTE: the turn count is only multiplied exactly for |x| below roughly
+// 10^5, past that the error grows with the spacing between floats
+static forceinline
+sse4Floats wrap_angle(sse4Floats x) {
+	sse4Floats pi = reint_i2f(sse4Ints::expand(0x40490fdb));			//        3.141593f
+	sse4Floats inv_two_pi = reint_i2f(sse4Ints::expand(0x3e22f983));	// 1.0f / 6.283185f
+	sse4Floats two_pi = pi + pi;
+
+	// the number of whole turns to remove
+	sse4Floats k = round(x * inv_two_pi);
+	sse4Floats rval = __sub_pi_multiple(x, k + k);
+
+	// x * inv_two_pi is rounded, so near odd multiples of PI the turn count
+	// can be off by one, leaving rval just past one of the endpoints
+	rval = blend4(rval >  pi, rval - two_pi, rval);
+	rval = blend4(rval < -pi, rval + two_pi, rval);
+
+	// float PI and true PI differ in the last place
+	return min4(max4(rval, -pi), pi);
+}
+
+
+// reference version
+static forceinline
+sse4Floats wrap_angle_ref(sse4Floats x) {
+	float arr[SSE_WIDTH];
+
+	for (int i = 0; i < SSE_WIDTH; i++) {
+		double d = remainder((double)x[i], 2.0 * 3.14159265358979323846);
+		arr[i] = clamp((float)d, -M_PI, M_PI);
+	}
+
+	return sse4Floats(arr[0], arr[1], arr[2], arr[3]);
 }
 
 
@@ -333,7 +568,7 @@ sse4Floats __exp_rd(sse4Floats x) {
 	sse4Floats log_2e = reint_i2f(sse4Ints::expand(0x3fb8aa3b));	// 1.442695f
 	sse4Floats log_e2 = reint_i2f(sse4Ints::expand(0x3f317218));	// 0.693147f
 
-	sse4Ints   pre_e = cast_f2i(log_2e*x);			// generates exponent
+	sse4Ints   pre_e = round_f2i(log_2e*x);			// generates exponent
 	sse4Floats pre_m = x - log_e2*cast_i2f(pre_e);	// generates mantissa
 
 	return __exp_exponent(pre_e) * __exp_mantissa(pre_m);
@@ -396,14 +631,15 @@ sse4Floats __sin_ror(sse4Floats x) {
 // fast version
 static forceinline
 sse4Floats sin(sse4Floats x) {
-	sse4Floats pi = reint_i2f(sse4Ints::expand(0x40490fdb));		//        3.141593f
 	sse4Floats inv_pi = reint_i2f(sse4Ints::expand(0x3ea2f983));	// 1.0f / 3.141593f
 
-	// figure out how many multiples of pi are in x
-	sse4Ints ipart  = cast_f2i(inv_pi*x);
+	// figure out the nearest multiple of pi to x, which leaves a
+	// remainder on [-PI/2, PI/2]
+	sse4Floats k = round(inv_pi*x);
 
-	// if ipart is odd, set the sign bit to make x_ror negative
-	sse4Floats x_ror = reint_i2f(ipart << 31) ^ (x - cast_i2f(ipart)*pi);
+	// if k is odd, set the sign bit to make x_ror negative
+	sse4Ints parity = cast_f2i(k) << 31;
+	sse4Floats x_ror = reint_i2f(parity) ^ __sub_pi_multiple(x, k);
 
 	return __sin_ror(x_ror);
 }
@@ -439,4 +675,33 @@ sse4Floats cos_ref(sse4Floats x) {
 }
 
 
+//--- SINCOS ---//
+
+// fast version, sin(x) and cos(x) from one range reduction, the remainder
+// r on [-PI/2, PI/2] gives cos(r) as sin(PI/2 - |r|), sin is the same
+// as sin() above
+static forceinline
+void sincos(sse4Floats x, sse4Floats &s, sse4Floats &c) {
+	sse4Floats inv_pi  = reint_i2f(sse4Ints::expand(0x3ea2f983));	// 1.0f / 3.141593f
+	sse4Floats half_pi = reint_i2f(sse4Ints::expand(0x3fc90fdb));	// 1.570796f
+
+	sse4Floats k = round(inv_pi*x);
+	sse4Floats r = __sub_pi_multiple(x, k);
+
+	// if k is odd, both are negated
+	sse4Floats parity = reint_i2f(cast_f2i(k) << 31);
+
+	s = parity ^ __sin_ror(r);
+	c = parity ^ __sin_ror(half_pi - abs(r));
+}
+
+
+// reference version
+static forceinline
+void sincos_ref(sse4Floats x, sse4Floats &s, sse4Floats &c) {
+	s = sin_ref(x);
+	c = cos_ref(x);
+}
+
+
 // end of sseMath.h
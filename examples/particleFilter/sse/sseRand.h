@@ -0,0 +1,64 @@
+#pragma once
+
+// four random number generators, one per lane, for drawing noise for
+// many particles at once
+
+#include "sys/common.h"
+#include "sys/rand.h"
+
+#include "sse/sse4Floats.h"
+#include "sse/sse4Ints.h"
+#include "sse/sseMath.h"
+
+
+// xorshift32 in each lane (see RandGen in sys/rand.h), the lanes are
+// seeded from one scalar generator so they do not start out correlated
+class sse4Rand {
+private:
+	sse4Ints state;		// never 0 in any lane
+
+public:
+	forceinline sse4Rand(unsigned int seed = 1) {
+		setSeed(seed);
+	}
+
+	void setSeed(unsigned int seed) {
+		RandGen rng(seed);
+
+		// the first outputs of xorshift follow the seed closely
+		for (int i = 0; i < 8; i++) {
+			rng.next();
+		}
+
+		int s[SSE_WIDTH];
+		for (int i = 0; i < SSE_WIDTH; i++) {
+			s[i] = (int)rng.next();
+		}
+		state = sse4Ints(s[0], s[1], s[2], s[3]);
+	}
+
+	forceinline sse4Ints next() {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	// generates random floats from the interval [0, 1), the top 23 bits
+	// become the mantissa of a float on [1, 2)
+	forceinline sse4Floats getUniform() {
+		sse4Ints one = sse4Ints::expand(0x3f800000);	// 1.0f
+		return reint_i2f((next() >> 9) | one) - reint_i2f(one);
+	}
+
+	// generates floats with mean 0 and standard deviation 1, close to a
+	// normal distribution, from the sum of four uniforms (Irwin-Hall),
+	// which needs no log or sqrt and never strays past 2*sqrt(3)
+	forceinline sse4Floats getNormal() {
+		sse4Floats sum = (getUniform() + getUniform()) + (getUniform() + getUniform());
+		return (sum - sse4Floats::expand(2.0f)) * sse4Floats::expand(1.7320508f);
+	}
+};
+
+
+// end of sseRand.h
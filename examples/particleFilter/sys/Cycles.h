@@ -0,0 +1,55 @@
+#pragma once
+
+// reads the processor's time stamp counter, for timing short stretches of code
+//
+// NOTE: on most processors the counter ticks at a constant rate regardless of
+// the current clock speed, so a "cycle" is a reference cycle and not
+// necessarily a core clock cycle
+
+#include "sys/crossplatform.h"
+#include "sys/Timer.h"
+
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+#include <emmintrin.h>
+
+
+typedef unsigned long long cycles_t;
+
+// reads the counter, may be reordered with the surrounding instructions
+static forceinline cycles_t getCycles() {
+	return __rdtsc();
+}
+
+// reads the counter after all earlier instructions have completed,
+// use this at the start and end of a timed region
+static forceinline cycles_t getCyclesSerialized() {
+	_mm_lfence();
+	cycles_t c = __rdtsc();
+	_mm_lfence();
+	return c;
+}
+
+// measures the rate of the counter against the wall clock,
+// takes about 50 ms, so call it once and keep the result
+static noinline double measureCyclesPerSecond() {
+	Timer t;
+	t.start();
+	cycles_t start = getCyclesSerialized();
+
+	double elapsed = 0.0;
+	do {
+		t.stop();
+		elapsed = t.getElapsedSeconds();
+	} while (elapsed < 0.05);
+
+	cycles_t end = getCyclesSerialized();
+	return (double)(end - start) / elapsed;
+}
+
+
+// end of Cycles.h
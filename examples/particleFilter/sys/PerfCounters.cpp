@@ -0,0 +1,269 @@
+// hardware performance counters around named code regions, Linux only
+
+#include <string.h>
+
+#include "PerfCounters.h"
+#include "Thread.h"
+
+#ifdef __linux__
+#include <cpuid.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+static const char *COUNTER_NAMES[NUM_PERF_COUNTERS] = {
+	"cycles",
+	"instructions",
+	"L1D misses",
+	"LLC misses",
+	"branch misses",
+	"FP assists"
+};
+
+// file descriptors of the open counters, -1 if unavailable
+static int counterFds[NUM_PERF_COUNTERS] = { -1, -1, -1, -1, -1, -1 };
+static bool countersOpened = false;
+static bool countersActive = false;
+
+// all regions in the order they were constructed, see Profiler.cpp
+static PerfRegion *regionList = NULL;
+static PerfRegion *regionListTail = NULL;
+
+// guards the list, see Profiler.cpp
+static volatile int regionListLock = 0;
+
+
+//--- COUNTERS ---//
+
+#ifdef __linux__
+
+// FP_ASSIST.ANY on Intel processors from Sandy Bridge through Skylake,
+// raw events mean something else on other vendors, so those go without
+static const unsigned long long INTEL_FP_ASSIST_ANY = 0x1eca;
+
+static bool isIntel() {
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx)) {
+		return false;
+	}
+
+	// "GenuineIntel" split across ebx, edx, ecx
+	return ebx == 0x756e6547 && edx == 0x49656e69 && ecx == 0x6c65746e;
+}
+
+static int openCounter(unsigned int type, unsigned long long config) {
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.inherit = 1;		// also count threads created later
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	// this process, any cpu, no group
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static unsigned long long cacheMissConfig(unsigned long long cache) {
+	return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+int initPerfCounters() {
+	if (!countersOpened) {
+		counterFds[PERF_CYCLES]        = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+		counterFds[PERF_INSTRUCTIONS]  = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+		counterFds[PERF_L1D_MISSES]    = openCounter(PERF_TYPE_HW_CACHE, cacheMissConfig(PERF_COUNT_HW_CACHE_L1D));
+		counterFds[PERF_LLC_MISSES]    = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+		counterFds[PERF_BRANCH_MISSES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+		counterFds[PERF_FP_ASSISTS]    = isIntel() ? openCounter(PERF_TYPE_RAW, INTEL_FP_ASSIST_ANY) : -1;
+		countersOpened = true;
+	}
+
+	int n = 0;
+	for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+		n += (counterFds[i] >= 0) ? 1 : 0;
+	}
+
+	countersActive = (n > 0);
+	return n;
+}
+
+void readPerfCounters(unsigned long long values[NUM_PERF_COUNTERS]) {
+	for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+		// value, time enabled, time running
+		unsigned long long buf[3];
+
+		if (counterFds[i] < 0 || read(counterFds[i], buf, sizeof(buf)) != sizeof(buf)) {
+			values[i] = 0;
+			continue;
+		}
+
+		// scale up if the kernel had to share the hardware counters
+		if (buf[2] != 0 && buf[2] < buf[1]) {
+			values[i] = (unsigned long long)((double)buf[0] * buf[1] / buf[2]);
+		} else {
+			values[i] = buf[0];
+		}
+	}
+}
+
+#else
+
+int initPerfCounters() {
+	countersOpened = true;
+	countersActive = false;
+	return 0;
+}
+
+void readPerfCounters(unsigned long long values[NUM_PERF_COUNTERS]) {
+	for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+		values[i] = 0;
+	}
+}
+
+#endif
+
+bool perfCountersActive() {
+	return countersActive;
+}
+
+bool isPerfCounterAvailable(PerfCounter c) {
+	return counterFds[c] >= 0;
+}
+
+const char *getPerfCounterName(PerfCounter c) {
+	return COUNTER_NAMES[c];
+}
+
+
+//--- REGIONS ---//
+
+static void lockRegionList() {
+	while (atomicAdd(&regionListLock, 1) != 0) {
+		atomicAdd(&regionListLock, -1);
+		Thread::yield();
+	}
+}
+
+static void unlockRegionList() {
+	atomicAdd(&regionListLock, -1);
+}
+
+PerfRegion::PerfRegion(const char *in_name)
+	: name(in_name), next(NULL)
+{
+	reset();
+
+	lockRegionList();
+	if (regionListTail == NULL) {
+		regionList = this;
+	} else {
+		regionListTail->next = this;
+	}
+	regionListTail = this;
+	unlockRegionList();
+}
+
+PerfRegion::~PerfRegion() {
+	lockRegionList();
+	PerfRegion *prev = NULL;
+	for (PerfRegion *r = regionList; r != this; r = r->next) {
+		prev = r;
+	}
+
+	if (prev == NULL) {
+		regionList = next;
+	} else {
+		prev->next = next;
+	}
+	if (regionListTail == this) {
+		regionListTail = prev;
+	}
+	unlockRegionList();
+}
+
+void PerfRegion::add(const unsigned long long start[NUM_PERF_COUNTERS],
+					 const unsigned long long end[NUM_PERF_COUNTERS],
+					 unsigned long long numUnits)
+{
+	for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+		// scaled counts are estimates and can step backwards
+		totals[i] += (end[i] > start[i]) ? end[i] - start[i] : 0;
+	}
+
+	calls++;
+	units += numUnits;
+}
+
+void PerfRegion::reset() {
+	for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+		totals[i] = 0;
+	}
+
+	calls = 0;
+	units = 0;
+}
+
+
+//--- REPORTING ---//
+
+// prints a count per particle update, or n/a if the counter is unavailable
+static void printPerUnit(FILE *fp, const PerfRegion *r, PerfCounter c) {
+	if (!isPerfCounterAvailable(c) || r->getUnits() == 0) {
+		fprintf(fp, " %10s", "n/a");
+	} else {
+		fprintf(fp, " %10.4f", (double)r->getTotal(c) / r->getUnits());
+	}
+}
+
+void dumpPerfRegions(FILE *fp) {
+	if (!perfCountersActive()) {
+		fprintf(fp, "no performance counters are available\n");
+		return;
+	}
+
+	fprintf(fp, "%-24s %8s %10s %10s %10s %10s %10s %10s\n", "region (per particle)",
+			"calls", "cycles", "IPC", "L1D miss", "LLC miss", "br miss", "FP assist");
+
+	lockRegionList();
+	for (PerfRegion *r = regionList; r != NULL; r = r->getNext()) {
+		if (r->getCalls() == 0) {
+			continue;
+		}
+
+		fprintf(fp, "%-24s %8llu", r->getName(), r->getCalls());
+		printPerUnit(fp, r, PERF_CYCLES);
+
+		// a region without units did not count all of its work
+		unsigned long long cycles = r->getTotal(PERF_CYCLES);
+		if (isPerfCounterAvailable(PERF_CYCLES) && isPerfCounterAvailable(PERF_INSTRUCTIONS) &&
+			cycles != 0 && r->getUnits() != 0) {
+			fprintf(fp, " %10.2f", (double)r->getTotal(PERF_INSTRUCTIONS) / cycles);
+		} else {
+			fprintf(fp, " %10s", "n/a");
+		}
+
+		printPerUnit(fp, r, PERF_L1D_MISSES);
+		printPerUnit(fp, r, PERF_LLC_MISSES);
+		printPerUnit(fp, r, PERF_BRANCH_MISSES);
+		printPerUnit(fp, r, PERF_FP_ASSISTS);
+		fprintf(fp, "\n");
+	}
+	unlockRegionList();
+}
+
+void resetPerfRegions() {
+	lockRegionList();
+	for (PerfRegion *r = regionList; r != NULL; r = r->getNext()) {
+		r->reset();
+	}
+	unlockRegionList();
+}
+
+
+// end of PerfCounters.cpp
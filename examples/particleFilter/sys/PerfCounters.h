@@ -0,0 +1,151 @@
+#pragma once
+
+// hardware performance counters around named code regions, Linux only
+//
+// a region is declared once at file scope and measured with a scoped object,
+// which is told how many particle updates the pass performs:
+//
+//   static PerfRegion regionUpdate("measurement update");
+//
+//   void update() {
+//       PERF_REGION(regionUpdate, numParticles * numObservations);
+//       ...
+//   }
+//
+// nothing is counted until initPerfCounters() succeeds, and counters the
+// processor or the kernel do not provide are reported as n/a, on other
+// platforms every counter is unavailable
+//
+// a region can also be a member of an object, it leaves the list when the
+// object is destroyed
+//
+// NOTE: the counters follow the thread that opens them and any threads it
+// creates afterwards, regions are not thread-safe, enter each from one thread
+
+#include <stdio.h>
+
+#include "sys/crossplatform.h"
+
+
+//--- COUNTERS ---//
+
+enum PerfCounter {
+	PERF_CYCLES,
+	PERF_INSTRUCTIONS,
+	PERF_L1D_MISSES,		// L1 data cache read misses
+	PERF_LLC_MISSES,		// last level cache misses
+	PERF_BRANCH_MISSES,
+	PERF_FP_ASSISTS,		// microcode assists for denormals and other special values
+	NUM_PERF_COUNTERS
+};
+
+// opens the counters for the calling thread, returns the number that are
+// available, safe to call more than once
+int initPerfCounters();
+
+// true once initPerfCounters() has opened at least one counter
+bool perfCountersActive();
+
+bool isPerfCounterAvailable(PerfCounter c);
+
+const char *getPerfCounterName(PerfCounter c);
+
+// reads every available counter into values, unavailable ones read 0
+void readPerfCounters(unsigned long long values[NUM_PERF_COUNTERS]);
+
+
+//--- REGIONS ---//
+
+class PerfRegion {
+private:
+	// instance variables
+	const char *name;
+	unsigned long long totals[NUM_PERF_COUNTERS];
+	unsigned long long calls;
+	unsigned long long units;		// particle updates, for the per-particle numbers
+
+	PerfRegion *next;				// all regions form a list, see PerfCounters.cpp
+
+	// not copyable, the region is linked into the list
+	PerfRegion(const PerfRegion &rhs);
+	PerfRegion &operator =(const PerfRegion &rhs);
+
+public:
+	PerfRegion(const char *in_name);
+	~PerfRegion();
+
+	void add(const unsigned long long start[NUM_PERF_COUNTERS],
+			 const unsigned long long end[NUM_PERF_COUNTERS],
+			 unsigned long long numUnits);
+
+	void reset();
+
+	const char *getName() const {
+		return name;
+	}
+
+	unsigned long long getCalls() const {
+		return calls;
+	}
+
+	unsigned long long getUnits() const {
+		return units;
+	}
+
+	unsigned long long getTotal(PerfCounter c) const {
+		return totals[c];
+	}
+
+	PerfRegion *getNext() const {
+		return next;
+	}
+};
+
+// reads the counters at its construction and destruction and adds
+// the difference to a region, does nothing if no counters are open
+class ScopedPerfRegion {
+private:
+	PerfRegion &region;
+	unsigned long long numUnits;
+	unsigned long long start[NUM_PERF_COUNTERS];
+	bool active;
+
+	ScopedPerfRegion(const ScopedPerfRegion &rhs);
+	ScopedPerfRegion &operator =(const ScopedPerfRegion &rhs);
+
+public:
+	ScopedPerfRegion(PerfRegion &in_region, unsigned long long in_numUnits)
+		: region(in_region), numUnits(in_numUnits), active(perfCountersActive())
+	{
+		if (active) {
+			readPerfCounters(start);
+		}
+	}
+
+	~ScopedPerfRegion() {
+		if (active) {
+			unsigned long long end[NUM_PERF_COUNTERS];
+			readPerfCounters(end);
+			region.add(start, end, numUnits);
+		}
+	}
+};
+
+#define _PERF_CONCAT2(a, b) a##b
+#define _PERF_CONCAT(a, b) _PERF_CONCAT2(a, b)
+
+#define PERF_REGION(region, numUnits) ScopedPerfRegion _PERF_CONCAT(__perfRegion, __LINE__)(region, numUnits)
+
+
+//--- REPORTING ---//
+
+// prints the totals of every region that was entered, with the
+// instructions per cycle and the misses and assists per particle update,
+// or n/a for a region entered with no particle updates
+void dumpPerfRegions(FILE *fp);
+
+// clears the totals of all regions
+void resetPerfRegions();
+
+
+// end of PerfCounters.h
@@ -0,0 +1,140 @@
+// low-overhead profiling of named code regions (zones)
+
+#include <math.h>
+
+#include "Profiler.h"
+#include "Thread.h"
+
+
+// all zones in the order they were constructed, zones are constructed during
+// static initialization, which is safe since this pointer is zero-initialized
+// before any constructors run
+static ProfileZone *zoneList = NULL;
+static ProfileZone *zoneListTail = NULL;
+
+// guards the list, which zones that are members of objects join and leave
+// on any thread, a spin lock since it is also zero before any constructors
+static volatile int zoneListLock = 0;
+
+// measured on the first dump
+static double cyclesPerSecond = 0.0;
+
+
+static void lockZoneList() {
+	while (atomicAdd(&zoneListLock, 1) != 0) {
+		atomicAdd(&zoneListLock, -1);
+		Thread::yield();
+	}
+}
+
+static void unlockZoneList() {
+	atomicAdd(&zoneListLock, -1);
+}
+
+
+ProfileZone::ProfileZone(const char *in_name)
+	: name(in_name), next(NULL)
+{
+	reset();
+
+	lockZoneList();
+	if (zoneListTail == NULL) {
+		zoneList = this;
+	} else {
+		zoneListTail->next = this;
+	}
+	zoneListTail = this;
+	unlockZoneList();
+}
+
+ProfileZone::~ProfileZone() {
+	lockZoneList();
+	ProfileZone *prev = NULL;
+	for (ProfileZone *z = zoneList; z != this; z = z->next) {
+		prev = z;
+	}
+
+	if (prev == NULL) {
+		zoneList = next;
+	} else {
+		prev->next = next;
+	}
+	if (zoneListTail == this) {
+		zoneListTail = prev;
+	}
+	unlockZoneList();
+}
+
+void ProfileZone::reset() {
+	for (int i = 0; i < NUM_BUCKETS; i++) {
+		hist[i] = 0;
+	}
+
+	count = 0;
+	total = 0;
+	maxCycles = 0;
+}
+
+cycles_t ProfileZone::getPercentile(double pct) const {
+	if (count == 0) {
+		return 0;
+	}
+
+	// the number of passes at or below the percentile, at least 1
+	double rank = pct * 0.01 * count;
+	unsigned int needed = (rank < 1.0) ? 1 : (unsigned int)ceil(rank);
+
+	unsigned int seen = 0;
+	for (int b = 0; b < NUM_BUCKETS; b++) {
+		seen += hist[b];
+		if (seen >= needed) {
+			// the bucket edge can be past the largest duration seen
+			cycles_t c = getBucketMax(b);
+			return (c < maxCycles) ? c : maxCycles;
+		}
+	}
+
+	return maxCycles;
+}
+
+
+ProfileZone *getProfileZones() {
+	return zoneList;
+}
+
+void dumpProfileZones(FILE *fp) {
+	if (cyclesPerSecond == 0.0) {
+		cyclesPerSecond = measureCyclesPerSecond();
+	}
+
+	double usPerCycle = 1.0e6 / cyclesPerSecond;
+
+	fprintf(fp, "%-24s %8s %10s %10s %10s %10s\n",
+			"zone (usec)", "count", "mean", "p50", "p99", "max");
+
+	lockZoneList();
+	for (ProfileZone *z = zoneList; z != NULL; z = z->getNext()) {
+		if (z->getCount() == 0) {
+			continue;
+		}
+
+		fprintf(fp, "%-24s %8u %10.1f %10.1f %10.1f %10.1f\n",
+				z->getName(), z->getCount(),
+				z->getMean() * usPerCycle,
+				z->getPercentile(50.0) * usPerCycle,
+				z->getPercentile(99.0) * usPerCycle,
+				z->getMax() * usPerCycle);
+	}
+	unlockZoneList();
+}
+
+void resetProfileZones() {
+	lockZoneList();
+	for (ProfileZone *z = zoneList; z != NULL; z = z->getNext()) {
+		z->reset();
+	}
+	unlockZoneList();
+}
+
+
+// end of Profiler.cpp
@@ -0,0 +1,174 @@
+#pragma once
+
+// low-overhead profiling of named code regions (zones)
+//
+// a zone is declared once at file scope and timed with a scoped object:
+//
+//   static ProfileZone zoneUpdate("measurement update");
+//
+//   void update() {
+//       PROFILE_ZONE(zoneUpdate);
+//       ...
+//   }
+//
+// every pass through the scope adds its duration in cycles to the zone's
+// histogram, dumpProfileZones() prints the count, mean, p50, p99, and max
+// of every zone, and while a trace is running (see Trace.h) each pass is
+// also added to the timeline
+//
+// a zone can also be a member of an object, it leaves the list when the
+// object is destroyed
+//
+// NOTE: the histograms are not thread-safe, time each zone from a single thread
+
+#include <stdio.h>
+
+#include "sys/crossplatform.h"
+#include "sys/Cycles.h"
+#include "sys/Trace.h"
+
+
+//--- COMPILE-TIME OPTIONS ---//
+
+// set _ENABLE_PROFILING to 0 to compile the zones out completely
+#define _ENABLE_PROFILING     1
+
+
+//--- ZONE ---//
+
+class ProfileZone {
+public:
+	// the histogram has SUB_BUCKETS linear buckets per power of 2,
+	// so percentiles are accurate to within 1 / SUB_BUCKETS
+	static const int SUB_BITS = 3;
+	static const int SUB_BUCKETS = 1 << SUB_BITS;
+	static const int NUM_BUCKETS = 64 * SUB_BUCKETS;
+
+private:
+	// instance variables
+	const char *name;
+	unsigned int hist[NUM_BUCKETS];
+	unsigned int count;
+	cycles_t total;
+	cycles_t maxCycles;
+
+	ProfileZone *next;		// all zones form a list, see Profiler.cpp
+
+	// not copyable, the zone is linked into the list
+	ProfileZone(const ProfileZone &rhs);
+	ProfileZone &operator =(const ProfileZone &rhs);
+
+	// the bucket of a duration, durations below SUB_BUCKETS cycles each have
+	// their own bucket, the rest are split by exponent and top mantissa bits
+	static forceinline int getBucket(cycles_t c) {
+		if (c < SUB_BUCKETS) {
+			return (int)c;
+		}
+
+		int e = 0;
+		for (cycles_t v = c >> SUB_BITS; v != 0; v >>= 1) {
+			e++;
+		}
+
+		int sub = (int)(c >> (e - 1)) & (SUB_BUCKETS - 1);
+		return e * SUB_BUCKETS + sub;
+	}
+
+	// the largest duration that falls into a bucket
+	static cycles_t getBucketMax(int b) {
+		if (b < SUB_BUCKETS) {
+			return b;
+		}
+
+		int e = b / SUB_BUCKETS;
+		cycles_t sub = b % SUB_BUCKETS;
+		return ((SUB_BUCKETS + sub + 1) << (e - 1)) - 1;
+	}
+
+public:
+	ProfileZone(const char *in_name);
+	~ProfileZone();
+
+	forceinline void record(cycles_t c) {
+		hist[getBucket(c)]++;
+		count++;
+		total += c;
+		maxCycles = (c > maxCycles) ? c : maxCycles;
+	}
+
+	void reset();
+
+	const char *getName() const {
+		return name;
+	}
+
+	unsigned int getCount() const {
+		return count;
+	}
+
+	cycles_t getMax() const {
+		return maxCycles;
+	}
+
+	double getMean() const {
+		return (count > 0) ? (double)total / count : 0.0;
+	}
+
+	// the duration that pct percent of the passes did not exceed, rounded
+	// up to the edge of its bucket, pct is on [0, 100]
+	cycles_t getPercentile(double pct) const;
+
+	ProfileZone *getNext() const {
+		return next;
+	}
+};
+
+
+//--- SCOPED TIMING ---//
+
+// records the time from its construction to its destruction into a zone
+class ScopedProfileZone {
+private:
+	ProfileZone &zone;
+	cycles_t start;
+
+	ScopedProfileZone(const ScopedProfileZone &rhs);
+	ScopedProfileZone &operator =(const ScopedProfileZone &rhs);
+
+public:
+	forceinline ScopedProfileZone(ProfileZone &in_zone)
+		: zone(in_zone), start(getCycles()) {}
+
+	forceinline ~ScopedProfileZone() {
+		cycles_t end = getCycles();
+		zone.record(end - start);
+
+		if (isTracing()) {
+			traceEvent(zone.getName(), start, end);
+		}
+	}
+};
+
+#define _PROFILE_CONCAT2(a, b) a##b
+#define _PROFILE_CONCAT(a, b) _PROFILE_CONCAT2(a, b)
+
+#if _ENABLE_PROFILING
+	#define PROFILE_ZONE(zone) ScopedProfileZone _PROFILE_CONCAT(__profileZone, __LINE__)(zone)
+#else
+	#define PROFILE_ZONE(zone)
+#endif
+
+
+//--- EXTERNAL INTERFACE ---//
+
+// the first zone, follow getNext() for the rest
+ProfileZone *getProfileZones();
+
+// prints one line per zone that has been entered, times are in microseconds
+void dumpProfileZones(FILE *fp);
+
+// clears the histograms of all zones
+void resetProfileZones();
+
+
+// end of Profiler.h
@@ -0,0 +1,115 @@
+#pragma once
+
+// a graph of tasks for ThreadPool::run(), each runs once the tasks it
+// depends on have finished
+//
+//   TaskGraph g(maxTasks, maxEdges);
+//   Task *a = g.add(updateChunk, &data, 0);
+//   Task *b = g.add(reduce, &data, 0);
+//   g.depend(b, a);                        // b runs after a
+//   pool.run(g);
+//
+// unlike a loop split into stages, a task starts as soon as its own inputs
+// are ready, so the stages of a graph overlap rather than waiting on each
+// other at a barrier
+
+#include "sys/crossplatform.h"
+#include "sys/debug.h"
+#include "sys/ThreadPool.h"
+
+
+struct Task {
+	CHUNK_FUNC func;
+	void *arg;
+	int index;				// passed to func as the chunk
+	const char *traceName;	// NULL if the task is not traced, see ThreadPool
+
+	int numDeps;			// the tasks this one waits on
+	volatile int pending;	// of those, the ones not finished yet, see ThreadPool
+	int firstEdge;			// the tasks that wait on this one, a list in the graph
+};
+
+// one task that waits on the task whose list the edge is in
+struct TaskEdge {
+	Task *task;
+	int next;				// the next edge in the list, or -1
+};
+
+
+class TaskGraph {
+private:
+	// instance variables
+	Task *tasks;
+	int numTasks;
+	int maxTasks;
+
+	TaskEdge *edges;
+	int numEdges;
+	int maxEdges;
+
+	// not copyable, owns the tasks
+	TaskGraph(const TaskGraph &rhs);
+	TaskGraph &operator =(const TaskGraph &rhs);
+
+public:
+	TaskGraph(int in_maxTasks, int in_maxEdges)
+		: tasks(new Task[in_maxTasks]), numTasks(0), maxTasks(in_maxTasks),
+		  edges(new TaskEdge[in_maxEdges]), numEdges(0), maxEdges(in_maxEdges) {}
+
+	~TaskGraph() {
+		delete[] tasks;
+		delete[] edges;
+	}
+
+	// removes every task
+	void clear() {
+		numTasks = 0;
+		numEdges = 0;
+	}
+
+	// adds a task that calls func(arg, index), traced under traceName
+	// if it is not NULL
+	Task *add(CHUNK_FUNC func, void *arg, int index, const char *traceName = NULL) {
+		dieIf(numTasks >= maxTasks, "too many tasks in graph");
+
+		Task *t = &tasks[numTasks++];
+		t->func = func;
+		t->arg = arg;
+		t->index = index;
+		t->traceName = traceName;
+		t->numDeps = 0;
+		t->pending = 0;
+		t->firstEdge = -1;
+		return t;
+	}
+
+	// task after does not start until task before has finished, a
+	// graph must not have cycles
+	void depend(Task *after, Task *before) {
+		dieIf(numEdges >= maxEdges, "too many edges in graph");
+
+		TaskEdge &e = edges[numEdges];
+		e.task = after;
+		e.next = before->firstEdge;
+		before->firstEdge = numEdges++;
+
+		after->numDeps++;
+	}
+
+	int getNumTasks() const {
+		return numTasks;
+	}
+
+	Task *getTask(int i) {
+		assert(i >= 0 && i < numTasks);
+		return &tasks[i];
+	}
+
+	const TaskEdge &getEdge(int i) const {
+		assert(i >= 0 && i < numEdges);
+		return edges[i];
+	}
+};
+
+
+// end of TaskGraph.h
@@ -0,0 +1,250 @@
+#pragma once
+
+// system-specific threading primitives
+
+#include "sys/crossplatform.h"
+#include "sys/debug.h"
+
+#ifdef _WIN32
+namespace Windows {
+	#include <windows.h>
+};
+#include <process.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <unistd.h>
+#endif
+
+
+// the entry point of a thread
+typedef void (*THREAD_FUNC)(void *arg);
+
+
+//--- ATOMICS ---//
+
+// adds val to *p and returns the previous value of *p
+static forceinline int atomicAdd(volatile int *p, int val) {
+#ifdef _WIN32
+	return Windows::InterlockedExchangeAdd((volatile Windows::LONG *)p, val);
+#else
+	return __sync_fetch_and_add(p, val);
+#endif
+}
+
+
+//--- THREAD ---//
+
+// a thread that runs a single function, must be joined before it is destroyed
+class Thread {
+private:
+	// instance variables
+	THREAD_FUNC func;
+	void *arg;
+	bool running;
+
+#ifdef _WIN32
+	Windows::HANDLE handle;
+
+	static unsigned __stdcall entry(void *self) {
+		Thread *t = (Thread *)self;
+		t->func(t->arg);
+		return 0;
+	}
+#else
+	pthread_t handle;
+
+	static void *entry(void *self) {
+		Thread *t = (Thread *)self;
+		t->func(t->arg);
+		return NULL;
+	}
+#endif
+
+	// not copyable, the handle is owned
+	Thread(const Thread &rhs);
+	Thread &operator =(const Thread &rhs);
+
+public:
+	Thread() : func(NULL), arg(NULL), running(false) {}
+
+	~Thread() {
+		assert(!running);
+	}
+
+	// starts running func(arg) on a new thread
+	void start(THREAD_FUNC in_func, void *in_arg) {
+		assert(!running);
+
+		func = in_func;
+		arg = in_arg;
+
+#ifdef _WIN32
+		handle = (Windows::HANDLE)_beginthreadex(NULL, 0, entry, this, 0, NULL);
+		dieIf(handle == 0, "could not create thread");
+#else
+		dieIf(pthread_create(&handle, NULL, entry, this) != 0, "could not create thread");
+#endif
+		running = true;
+	}
+
+	// waits for the thread function to return
+	void join() {
+		assert(running);
+
+#ifdef _WIN32
+		Windows::WaitForSingleObject(handle, INFINITE);
+		Windows::CloseHandle(handle);
+#else
+		pthread_join(handle, NULL);
+#endif
+		running = false;
+	}
+
+	// gives the rest of the calling thread's time slice to another thread
+	static void yield() {
+#ifdef _WIN32
+		Windows::SwitchToThread();
+#else
+		sched_yield();
+#endif
+	}
+
+	// the number of logical processors in the machine, at least 1
+	static int getNumProcessors() {
+#ifdef _WIN32
+		Windows::SYSTEM_INFO info;
+		Windows::GetSystemInfo(&info);
+		int n = (int)info.dwNumberOfProcessors;
+#else
+		int n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+		return (n > 0) ? n : 1;
+	}
+};
+
+
+//--- MUTEX ---//
+
+class Mutex {
+private:
+	// instance variables
+#ifdef _WIN32
+	Windows::CRITICAL_SECTION cs;
+#else
+	pthread_mutex_t m;
+#endif
+
+	// not copyable
+	Mutex(const Mutex &rhs);
+	Mutex &operator =(const Mutex &rhs);
+
+public:
+	Mutex() {
+#ifdef _WIN32
+		Windows::InitializeCriticalSection(&cs);
+#else
+		pthread_mutex_init(&m, NULL);
+#endif
+	}
+
+	~Mutex() {
+#ifdef _WIN32
+		Windows::DeleteCriticalSection(&cs);
+#else
+		pthread_mutex_destroy(&m);
+#endif
+	}
+
+	void lock() {
+#ifdef _WIN32
+		Windows::EnterCriticalSection(&cs);
+#else
+		pthread_mutex_lock(&m);
+#endif
+	}
+
+	void unlock() {
+#ifdef _WIN32
+		Windows::LeaveCriticalSection(&cs);
+#else
+		pthread_mutex_unlock(&m);
+#endif
+	}
+};
+
+// locks a mutex for the lifetime of the object
+class ScopedLock {
+private:
+	Mutex &mutex;
+
+	ScopedLock(const ScopedLock &rhs);
+	ScopedLock &operator =(const ScopedLock &rhs);
+
+public:
+	ScopedLock(Mutex &in_mutex) : mutex(in_mutex) {
+		mutex.lock();
+	}
+
+	~ScopedLock() {
+		mutex.unlock();
+	}
+};
+
+
+//--- SEMAPHORE ---//
+
+// a counter that threads can wait on, wait() blocks until the count is
+// above 0 and then decrements it
+class Semaphore {
+private:
+	// instance variables
+#ifdef _WIN32
+	Windows::HANDLE handle;
+#else
+	sem_t sem;
+#endif
+
+	// not copyable
+	Semaphore(const Semaphore &rhs);
+	Semaphore &operator =(const Semaphore &rhs);
+
+public:
+	Semaphore(int count = 0) {
+#ifdef _WIN32
+		handle = Windows::CreateSemaphore(NULL, count, 0x7fffffff, NULL);
+		dieIf(handle == NULL, "could not create semaphore");
+#else
+		dieIf(sem_init(&sem, 0, count) != 0, "could not create semaphore");
+#endif
+	}
+
+	~Semaphore() {
+#ifdef _WIN32
+		Windows::CloseHandle(handle);
+#else
+		sem_destroy(&sem);
+#endif
+	}
+
+	void post() {
+#ifdef _WIN32
+		Windows::ReleaseSemaphore(handle, 1, NULL);
+#else
+		sem_post(&sem);
+#endif
+	}
+
+	void wait() {
+#ifdef _WIN32
+		Windows::WaitForSingleObject(handle, INFINITE);
+#else
+		// retry if a signal wakes the thread early
+		while (sem_wait(&sem) != 0) {}
+#endif
+	}
+};
+
+
+// end of Thread.h
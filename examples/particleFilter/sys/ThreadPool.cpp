@@ -0,0 +1,254 @@
+// a persistent set of worker threads that split loops over chunks of work
+
+#include "ThreadPool.h"
+#include "TaskGraph.h"
+#include "Trace.h"
+
+
+// calls func(arg, index), and records it on the calling thread if it has
+// a trace name and a trace is running
+static forceinline void runTraced(CHUNK_FUNC func, void *arg, int index, const char *traceName) {
+	if (traceName == NULL || !isTracing()) {
+		func(arg, index);
+		return;
+	}
+
+	cycles_t start = getCycles();
+	func(arg, index);
+	traceEvent(traceName, start, getCycles());
+}
+
+
+ThreadPool::ThreadPool(int in_numThreads, THREAD_FUNC in_initWorker, void *in_initArg)
+	: numThreads((in_numThreads > 0) ? in_numThreads : Thread::getNumProcessors()),
+	  workers(NULL), initWorker(in_initWorker), initArg(in_initArg),
+	  func(NULL), arg(NULL), numChunks(0), traceName(NULL), nextChunk(0),
+	  graph(NULL), deques(NULL), tasksLeft(0)
+{
+	if (numThreads > 1) {
+		workers = new Worker[numThreads - 1];
+	}
+	deques = new TaskDeque[numThreads];
+
+	for (int i = 0; i < numThreads - 1; i++) {
+		workers[i].pool = this;
+		workers[i].id = i + 1;
+		workers[i].thread.start(workerMain, &workers[i]);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	// wake the workers with no loop to run
+	func = NULL;
+	for (int i = 0; i < numThreads - 1; i++) {
+		workers[i].start.post();
+	}
+
+	for (int i = 0; i < numThreads - 1; i++) {
+		workers[i].thread.join();
+	}
+
+	delete[] workers;
+	delete[] deques;
+}
+
+void ThreadPool::workerMain(void *arg) {
+	Worker *w = (Worker *)arg;
+	ThreadPool *pool = w->pool;
+
+	if (pool->initWorker != NULL) {
+		pool->initWorker(pool->initArg);
+	}
+
+	for (;;) {
+		w->start.wait();
+		if (pool->func == NULL) {
+			break;
+		}
+
+		if (pool->func == runGraphFunc) {
+			pool->runTasks(w->id);
+		} else {
+			pool->runChunks();
+		}
+		pool->done.post();
+	}
+}
+
+void ThreadPool::runChunks() {
+	for (;;) {
+		int c = atomicAdd(&nextChunk, 1);
+		if (c >= numChunks) {
+			break;
+		}
+
+		runTraced(func, arg, c, traceName);
+	}
+}
+
+void ThreadPool::run(CHUNK_FUNC in_func, void *in_arg, int in_numChunks, const char *in_traceName) {
+	assert(in_func != NULL);
+
+	// one chunk is not worth waking the workers for
+	if (numThreads == 1 || in_numChunks <= 1) {
+		for (int c = 0; c < in_numChunks; c++) {
+			runTraced(in_func, in_arg, c, in_traceName);
+		}
+		return;
+	}
+
+	func = in_func;
+	arg = in_arg;
+	numChunks = in_numChunks;
+	traceName = in_traceName;
+	nextChunk = 0;
+
+	// the semaphores order these writes before the workers read them
+	for (int i = 0; i < numThreads - 1; i++) {
+		workers[i].start.post();
+	}
+
+	runChunks();
+
+	for (int i = 0; i < numThreads - 1; i++) {
+		done.wait();
+	}
+}
+
+
+//--- TASK GRAPHS ---//
+
+void ThreadPool::TaskDeque::reserve(int n) {
+	if (n > capacity) {
+		delete[] items;
+		items = new Task *[n];
+		capacity = n;
+	}
+
+	head = 0;
+	size = 0;
+}
+
+void ThreadPool::TaskDeque::pushBack(Task *t) {
+	ScopedLock lock(mutex);
+	assert(size < capacity);
+
+	items[(head + size) % capacity] = t;
+	size++;
+}
+
+Task *ThreadPool::TaskDeque::popBack() {
+	ScopedLock lock(mutex);
+	if (size == 0) {
+		return NULL;
+	}
+
+	size--;
+	return items[(head + size) % capacity];
+}
+
+Task *ThreadPool::TaskDeque::popFront() {
+	ScopedLock lock(mutex);
+	if (size == 0) {
+		return NULL;
+	}
+
+	Task *t = items[head];
+	head = (head + 1) % capacity;
+	size--;
+	return t;
+}
+
+void ThreadPool::runGraphFunc(void *arg, int chunk) {
+	(void)arg;
+	(void)chunk;
+	assert(false);		// never called, only compared against
+}
+
+void ThreadPool::runTasks(int id) {
+	TaskDeque &own = deques[id];
+
+	for (;;) {
+		Task *t = own.popBack();
+
+		// steal the oldest task of the next thread that has one
+		for (int i = 1; t == NULL && i < numThreads; i++) {
+			t = deques[(id + i) % numThreads].popFront();
+		}
+
+		if (t == NULL) {
+			if (tasksLeft == 0) {
+				break;
+			}
+
+			// the tasks left are running on other threads
+			Thread::yield();
+			continue;
+		}
+
+		runTraced(t->func, t->arg, t->index, t->traceName);
+
+		// the tasks waiting on only this one are ready, the atomic orders
+		// the writes of this task before the successor's reads
+		for (int e = t->firstEdge; e != -1; e = graph->getEdge(e).next) {
+			Task *succ = graph->getEdge(e).task;
+			if (atomicAdd(&succ->pending, -1) == 1) {
+				own.pushBack(succ);
+			}
+		}
+
+		atomicAdd(&tasksLeft, -1);
+	}
+}
+
+void ThreadPool::run(TaskGraph &in_graph) {
+	int n = in_graph.getNumTasks();
+	if (n == 0) {
+		return;
+	}
+
+	graph = &in_graph;
+	tasksLeft = n;
+
+	for (int i = 0; i < numThreads; i++) {
+		deques[i].reserve(n);
+	}
+
+	for (int i = 0; i < n; i++) {
+		Task *t = in_graph.getTask(i);
+		t->pending = t->numDeps;
+	}
+
+	// the tasks with nothing to wait on are dealt out to the threads, last
+	// first, so each thread starts on the first of its share
+	int next = 0;
+	for (int i = n - 1; i >= 0; i--) {
+		Task *t = in_graph.getTask(i);
+		if (t->numDeps == 0) {
+			deques[next].pushBack(t);
+			next = (next + 1) % numThreads;
+		}
+	}
+
+	if (numThreads == 1) {
+		runTasks(0);
+	} else {
+		func = runGraphFunc;
+
+		// the semaphores order these writes before the workers read them
+		for (int i = 0; i < numThreads - 1; i++) {
+			workers[i].start.post();
+		}
+
+		runTasks(0);
+
+		for (int i = 0; i < numThreads - 1; i++) {
+			done.wait();
+		}
+	}
+
+	graph = NULL;
+}
+
+
+// end of ThreadPool.cpp
@@ -0,0 +1,126 @@
+#pragma once
+
+// a persistent set of worker threads that split loops over chunks of work
+//
+// the threads are created once and wait between loops, so a loop that
+// runs every frame does not pay for creating threads:
+//
+//   static void updateChunk(void *arg, int chunk) { ... }
+//
+//   ThreadPool pool(0);                    // one thread per processor
+//   pool.run(updateChunk, &data, numChunks);
+//
+// the chunks are handed out from a shared counter to the workers and the
+// calling thread, which takes part in the loop, so func may run for any
+// chunk on any thread and must only write to the data of its own chunk,
+// results that are combined in chunk order do not depend on the number
+// of threads
+//
+// the pool also runs graphs of tasks (see TaskGraph.h) with work stealing:
+// each thread has a deque of tasks that are ready, it runs the task it
+// pushed last, which is usually the one whose inputs it just wrote, and
+// when its deque is empty it steals the oldest task from another thread
+//
+// a loop or task given a trace name is recorded as an event on the thread
+// that runs it while a trace is running (see Trace.h), so the timeline
+// shows how the work was spread over the threads
+
+#include "sys/crossplatform.h"
+#include "sys/Thread.h"
+
+
+// runs one chunk of a loop
+typedef void (*CHUNK_FUNC)(void *arg, int chunk);
+
+class TaskGraph;
+struct Task;
+
+
+class ThreadPool {
+private:
+	// one worker thread and the semaphore it waits on between loops
+	struct Worker {
+		ThreadPool *pool;
+		int id;					// 0 is the calling thread
+		Thread thread;
+		Semaphore start;
+	};
+
+	// the ready tasks of one thread, the owner pushes and pops at the
+	// back, thieves take from the front, tasks are large enough that
+	// a lock is cheap next to them
+	struct TaskDeque {
+		Mutex mutex;
+		Task **items;			// ring of capacity items
+		int capacity;
+		int head;				// the oldest task
+		int size;
+
+		TaskDeque() : items(NULL), capacity(0), head(0), size(0) {}
+		~TaskDeque() { delete[] items; }
+
+		void reserve(int n);
+		void pushBack(Task *t);
+		Task *popBack();
+		Task *popFront();
+	};
+
+	// instance variables
+	int numThreads;				// including the calling thread
+	Worker *workers;			// numThreads - 1 of them
+	Semaphore done;				// posted by each worker at the end of a loop
+
+	THREAD_FUNC initWorker;		// run once on each worker thread
+	void *initArg;
+
+	// the loop that is running
+	CHUNK_FUNC func;			// NULL tells the workers to quit
+	void *arg;
+	int numChunks;
+	const char *traceName;		// NULL if the chunks are not traced
+	volatile int nextChunk;
+
+	// the graph that is running, when func is runGraphFunc
+	TaskGraph *graph;
+	TaskDeque *deques;			// one per thread
+	volatile int tasksLeft;
+
+	// not copyable, owns the threads
+	ThreadPool(const ThreadPool &rhs);
+	ThreadPool &operator =(const ThreadPool &rhs);
+
+	static void workerMain(void *arg);
+
+	// runs chunks until there are none left
+	void runChunks();
+
+	// runs tasks of the graph on thread id until every task has run
+	void runTasks(int id);
+
+	// marks the graph as the running loop
+	static void runGraphFunc(void *arg, int chunk);
+
+public:
+	// numThreads includes the calling thread, 0 means one per processor,
+	// initWorker(initArg) is run first on each worker thread, for state
+	// such as the SSE control register that every thread has its own of
+	ThreadPool(int numThreads, THREAD_FUNC initWorker = NULL, void *initArg = NULL);
+
+	~ThreadPool();
+
+	// calls func(arg, c) for every c on [0, numChunks) and returns once
+	// all of them have returned, must only be called from one thread,
+	// each chunk is traced under traceName if it is not NULL
+	void run(CHUNK_FUNC func, void *arg, int numChunks, const char *traceName = NULL);
+
+	// runs every task of the graph and returns once all have returned,
+	// the graph can be run again, must only be called from one thread
+	void run(TaskGraph &graph);
+
+	int getNumThreads() const {
+		return numThreads;
+	}
+};
+
+
+// end of ThreadPool.h
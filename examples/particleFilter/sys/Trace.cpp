@@ -0,0 +1,100 @@
+// timeline of named code regions, written as a Chrome trace
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Trace.h"
+#include "Thread.h"
+#include "sysMath.h"
+
+
+volatile bool traceActive = false;
+
+static TraceEvent *events = NULL;
+static int maxTraceEvents = 0;
+static volatile int nextEvent = 0;			// may run past maxTraceEvents
+static cycles_t traceStart = 0;
+
+static volatile int nextThreadId = 0;
+static threadlocal int threadId = -1;
+
+
+void startTrace(int maxEvents) {
+	traceActive = false;
+
+	free(events);
+	events = (TraceEvent *)malloc(sizeof(TraceEvent) * maxEvents);
+	dieIf(events == NULL, "could not allocate the trace buffer");
+
+	maxTraceEvents = maxEvents;
+	nextEvent = 0;
+	traceStart = getCycles();
+
+	traceActive = true;
+}
+
+void stopTrace() {
+	traceActive = false;
+}
+
+void traceEvent(const char *name, cycles_t start, cycles_t end) {
+	if (!traceActive) {
+		return;
+	}
+
+	int i = atomicAdd(&nextEvent, 1);
+	if (i >= maxTraceEvents) {
+		return;
+	}
+
+	TraceEvent &e = events[i];
+	e.name = name;
+	e.start = start;
+	e.duration = end - start;
+	e.tid = getTraceThreadId();
+}
+
+int getTraceThreadId() {
+	if (threadId < 0) {
+		threadId = atomicAdd(&nextThreadId, 1);
+	}
+
+	return threadId;
+}
+
+int getNumTraceEvents() {
+	return min(nextEvent, maxTraceEvents);
+}
+
+int getNumDroppedTraceEvents() {
+	return max(nextEvent - maxTraceEvents, 0);
+}
+
+bool writeTrace(const char *filename) {
+	FILE *fp = fopen(filename, "w");
+	if (fp == NULL) {
+		return false;
+	}
+
+	double usPerCycle = 1.0e6 / measureCyclesPerSecond();
+	int n = getNumTraceEvents();
+
+	fprintf(fp, "{\"traceEvents\":[\n");
+	for (int i = 0; i < n; i++) {
+		const TraceEvent &e = events[i];
+
+		// events that started before the trace are clamped to its start
+		double ts  = (e.start > traceStart) ? (e.start - traceStart) * usPerCycle : 0.0;
+		double dur = e.duration * usPerCycle;
+
+		fprintf(fp, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}%s\n",
+				e.name, ts, dur, e.tid, (i + 1 < n) ? "," : "");
+	}
+	fprintf(fp, "],\n\"otherData\":{\"droppedEvents\":%d}}\n", getNumDroppedTraceEvents());
+
+	fclose(fp);
+	return true;
+}
+
+
+// end of Trace.cpp
@@ -0,0 +1,59 @@
+#pragma once
+
+// timeline of named code regions, written as a Chrome trace
+//
+// while a trace is running, every profile zone (see Profiler.h) that closes
+// appends an event with its name, start, duration, and thread to a fixed-size
+// buffer, as does every named chunk or task a ThreadPool runs, writers reserve
+// slots with an atomic increment, so any number of threads can record at once
+// without locks
+//
+// the buffer is written out by writeTrace() as JSON, which can be loaded into
+// chrome://tracing or ui.perfetto.dev
+//
+// NOTE: stopTrace() and writeTrace() must not run while other threads are
+// still recording, call them between frames
+
+#include "sys/crossplatform.h"
+#include "sys/Cycles.h"
+
+
+// one closed zone
+struct TraceEvent {
+	const char *name;	// must outlive the trace, like the names of zones
+	cycles_t start;
+	cycles_t duration;
+	int tid;			// small per-thread number, see getTraceThreadId()
+};
+
+
+// true while a trace is running, read on every zone exit
+extern volatile bool traceActive;
+
+static forceinline bool isTracing() {
+	return traceActive;
+}
+
+// starts a trace that holds up to maxEvents events, events past that are
+// dropped and counted, any previous trace is discarded
+void startTrace(int maxEvents);
+
+// stops recording, the events are kept until the next startTrace()
+void stopTrace();
+
+// appends an event, does nothing if the trace is not running
+void traceEvent(const char *name, cycles_t start, cycles_t end);
+
+// the calling thread's id in the trace, assigned on first use
+int getTraceThreadId();
+
+// the number of events recorded and dropped in the current trace
+int getNumTraceEvents();
+int getNumDroppedTraceEvents();
+
+// writes the recorded events as a Chrome trace, returns false if the file
+// could not be opened
+bool writeTrace(const char *filename);
+
+
+// end of Trace.h
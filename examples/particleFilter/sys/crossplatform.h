@@ -6,10 +6,12 @@
 	// definitions for MSVS and ICC on Windows
 	#define forceinline __forceinline
 	#define noinline __declspec(noinline)
+	#define threadlocal __declspec(thread)
 #else
 	// definitions for GCC
 	#define forceinline __attribute__((always_inline))
 	#define noinline __attribute__((noinline))
+	#define threadlocal __thread
 	#define __debugbreak()
 #endif
 
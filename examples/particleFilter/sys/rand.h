@@ -18,4 +18,35 @@ static forceinline float getRand(float base, float span) {
 	return base + span * nf;
 }
 
+// a random number generator with its own state, so that code running on
+// several threads at once gets the same numbers as when run alone
+//
+// uses xorshift32, which is fast and good enough for placing particles
+class RandGen {
+private:
+	unsigned int state;		// never 0
+
+public:
+	forceinline RandGen(unsigned int seed = 1) {
+		setSeed(seed);
+	}
+
+	forceinline void setSeed(unsigned int seed) {
+		state = (seed != 0) ? seed : 0x9e3779b9u;
+	}
+
+	forceinline unsigned int next() {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	// generates a random float from the interval [base, base + span)
+	forceinline float getRand(float base, float span) {
+		float nf = (next() >> 8) * (1.0f / 16777216.0f);	// 24 bits
+		return base + span * nf;
+	}
+};
+
 // end of rand.h
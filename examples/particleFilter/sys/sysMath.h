@@ -67,6 +67,12 @@ static forceinline int clamp(int val, int lo, int hi) {
 	return max(lo, min(val, hi));
 }
 
+// clamp to [lo, hi]
+static forceinline float clamp(float val, float lo, float hi) {
+	assert(lo <= hi);
+	return max(lo, min(val, hi));
+}
+
 // inclusive bounds [lo, hi]
 static forceinline bool inbounds(float val, float lo, float hi) {
 	return (val >= lo && val <= hi);
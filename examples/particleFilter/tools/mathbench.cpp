@@ -0,0 +1,428 @@
+// microbenchmarks for the SSE math functions
+//
+// each function is measured in three modes, all in time stamp counter cycles:
+//   latency     x = f(x) chained, cycles per call (one 4-wide vector)
+//   throughput  8 independent vectors held in registers, cycles per element
+//   batch       an L1-resident array read from and written to memory, cycles per element
+//
+// "lut" is the bare table lookup of exp_lut() on its reduced range, its array
+// tiers only have a batch mode, which goes through sseLut::lookup_array(), the
+// one path that uses the AVX2 8-wide gather, and their results are checked
+// against the 4-wide lookup()
+//
+// every measurement is repeated after a warmup run, and the min, median,
+// mean, and standard deviation of the repetitions are reported, the
+// minimum is the most stable number to track over time
+//
+// usage: mathbench [options] [func ...]
+//   -reps <n>     repetitions of each measurement, defaults to 15
+//   -iters <n>    calls per repetition, defaults to 100000
+//   -list         lists the functions and their tiers
+//
+// if no functions are named, all of them are measured, the program exits with
+// a non-zero status if an array lookup does not match the 4-wide one
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sys/common.h"
+#include "sys/Cycles.h"
+#include "sys/mem.h"
+#include "sys/rand.h"
+
+#include "sse/sseMath.h"
+#include "sse/sseLut.h"
+
+
+typedef sse4Floats (*ONE_ARG_FUNC)(sse4Floats x);
+
+// returns cycles per call or per element, see the top of the file
+typedef double (*BENCH_FUNC)(const float *in, float *out, int iters);
+
+// number of segments in each of the lookup tables, same as Comparison.cpp
+static const int LUT_SEGMENTS = 256;
+
+// number of independent vectors in the throughput mode, enough to cover
+// the latency of the longest functions on current processors
+static const int NUM_CHAINS = 8;
+
+// number of floats in the batch arrays, in and out together fit in L1
+static const int BATCH_SIZE = 1024;
+
+static const int DEFAULT_REPS = 15;
+static const int DEFAULT_ITERS = 100000;
+
+static sseLut expLutLinear;
+static sseLut expLutQuadratic;
+static sseLut atanLutLinear;
+static sseLut atanLutQuadratic;
+
+// number of array lookups that did not match the 4-wide lookups
+static int numArrayMismatches = 0;
+
+
+//--- OPTIMIZATION BARRIER ---//
+
+// hides the value of x from the compiler, so that a computation on
+// it cannot be hoisted out of a loop or removed as unused
+static forceinline void opaque(sse4Floats &x) {
+#ifdef _WIN32
+	// no inline assembly in 64-bit MSVC, a round trip through memory
+	// adds a few cycles to every measurement
+	static volatile __m128 sink;
+	sink = x.data;
+	x = sse4Floats(sink);
+#else
+	__asm__ __volatile__("" : "+x"(x.data));
+#endif
+}
+
+
+//--- LOCAL WRAPPERS ---//
+
+// the following functions must all be non-static
+
+sse4Floats abs_loc(sse4Floats x)            { return abs(x); }
+sse4Floats abs_ref_loc(sse4Floats x)        { return abs_ref(x); }
+sse4Floats trunc_loc(sse4Floats x)          { return trunc(x); }
+sse4Floats trunc_ref_loc(sse4Floats x)      { return trunc_ref(x); }
+sse4Floats floor_loc(sse4Floats x)          { return floor(x); }
+sse4Floats floor_ref_loc(sse4Floats x)      { return floor_ref(x); }
+sse4Floats ceil_loc(sse4Floats x)           { return ceil(x); }
+sse4Floats ceil_ref_loc(sse4Floats x)       { return ceil_ref(x); }
+sse4Floats round_loc(sse4Floats x)          { return round(x); }
+sse4Floats round_ref_loc(sse4Floats x)      { return round_ref(x); }
+sse4Floats wrap_angle_loc(sse4Floats x)     { return wrap_angle(x); }
+sse4Floats wrap_angle_ref_loc(sse4Floats x) { return wrap_angle_ref(x); }
+sse4Floats exp_loc(sse4Floats x)            { return exp(x); }
+sse4Floats exp_ref_loc(sse4Floats x)        { return exp_ref(x); }
+sse4Floats sin_loc(sse4Floats x)            { return sin(x); }
+sse4Floats sin_ref_loc(sse4Floats x)        { return sin_ref(x); }
+sse4Floats cos_loc(sse4Floats x)            { return cos(x); }
+sse4Floats cos_ref_loc(sse4Floats x)        { return cos_ref(x); }
+sse4Floats sincos_loc(sse4Floats x)         { sse4Floats s, c; sincos(x, s, c); return s + c; }
+sse4Floats sincos_ref_loc(sse4Floats x)     { sse4Floats s, c; sincos_ref(x, s, c); return s + c; }
+sse4Floats atan_loc(sse4Floats x)           { return atan(x); }
+sse4Floats atan_ref_loc(sse4Floats x)       { return atan_ref(x); }
+sse4Floats exp_lut_lin_loc(sse4Floats x)    { return exp_lut(expLutLinear, x); }
+sse4Floats exp_lut_quad_loc(sse4Floats x)   { return exp_lut(expLutQuadratic, x); }
+sse4Floats atan_lut_lin_loc(sse4Floats x)   { return atan_lut(atanLutLinear, x); }
+sse4Floats atan_lut_quad_loc(sse4Floats x)  { return atan_lut(atanLutQuadratic, x); }
+sse4Floats lut_lin_loc(sse4Floats x)        { return expLutLinear.lookup(x); }
+sse4Floats lut_quad_loc(sse4Floats x)       { return expLutQuadratic.lookup(x); }
+
+// atan2 on the unit circle, the input is the angle
+sse4Floats atan2_loc(sse4Floats x)          { return atan2(sin(x), cos(x)); }
+sse4Floats atan2_ref_loc(sse4Floats x)      { return atan2_ref(sin(x), cos(x)); }
+
+
+//--- BENCHMARK LOOPS ---//
+
+// chains every call on the result of the previous one, the math functions
+// have no data-dependent branches, so the values along the chain do not
+// affect the timing
+template <ONE_ARG_FUNC func>
+static noinline
+double benchLatency(const float *in, float *out, int iters) {
+	sse4Floats x = sse4Floats(_mm_load_ps(in));
+
+	cycles_t start = getCyclesSerialized();
+	for (int i = 0; i < iters; i++) {
+		x = func(x);
+	}
+	cycles_t end = getCyclesSerialized();
+
+	_mm_store_ps(out, x.data);
+	return (double)(end - start) / iters;
+}
+
+// keeps NUM_CHAINS independent calls in flight
+template <ONE_ARG_FUNC func>
+static noinline
+double benchThroughput(const float *in, float *out, int iters) {
+	sse4Floats x[NUM_CHAINS];
+	for (int k = 0; k < NUM_CHAINS; k++) {
+		x[k] = sse4Floats(_mm_load_ps(in + k*SSE_WIDTH));
+	}
+
+	cycles_t start = getCyclesSerialized();
+	for (int i = 0; i < iters; i += NUM_CHAINS) {
+		for (int k = 0; k < NUM_CHAINS; k++) {
+			opaque(x[k]);
+			sse4Floats r = func(x[k]);
+			opaque(r);
+		}
+	}
+	cycles_t end = getCyclesSerialized();
+
+	for (int k = 0; k < NUM_CHAINS; k++) {
+		_mm_store_ps(out + k*SSE_WIDTH, x[k].data);
+	}
+
+	return (double)(end - start) / ((double)iters * SSE_WIDTH);
+}
+
+// streams the input array through the function into the output array
+template <ONE_ARG_FUNC func>
+static noinline
+double benchBatch(const float *in, float *out, int iters) {
+	int passes = max(iters / (BATCH_SIZE / SSE_WIDTH), 1);
+
+	cycles_t start = getCyclesSerialized();
+	for (int p = 0; p < passes; p++) {
+		for (int i = 0; i < BATCH_SIZE; i += SSE_WIDTH) {
+			sse4Floats x = sse4Floats(_mm_load_ps(in + i));
+			_mm_store_ps(out + i, func(x).data);
+		}
+	}
+	cycles_t end = getCyclesSerialized();
+
+	return (double)(end - start) / ((double)passes * BATCH_SIZE);
+}
+
+// same as benchBatch(), but the whole array is looked up with one call to
+// lookup_array(), whose results must match lookup() to the bit
+static double benchArray(const sseLut &lut, const float *in, float *out, int iters) {
+	int passes = max(iters / (BATCH_SIZE / SSE_WIDTH), 1);
+
+	cycles_t start = getCyclesSerialized();
+	for (int p = 0; p < passes; p++) {
+		lut.lookup_array(in, out, BATCH_SIZE);
+	}
+	cycles_t end = getCyclesSerialized();
+
+	for (int i = 0; i < BATCH_SIZE; i += SSE_WIDTH) {
+		float ref[SSE_WIDTH];
+		_mm_storeu_ps(ref, lut.lookup(sse4Floats(_mm_load_ps(in + i))).data);
+
+		if (memcmp(ref, out + i, sizeof(ref)) != 0) {
+			numArrayMismatches++;
+		}
+	}
+
+	return (double)(end - start) / ((double)passes * BATCH_SIZE);
+}
+
+double lut_lin_array(const float *in, float *out, int iters)  { return benchArray(expLutLinear, in, out, iters); }
+double lut_quad_array(const float *in, float *out, int iters) { return benchArray(expLutQuadratic, in, out, iters); }
+
+
+//--- FUNCTION TABLE ---//
+
+static void initExpLuts() {
+	initExpLut(expLutLinear,    LUT_SEGMENTS, LUT_LINEAR);
+	initExpLut(expLutQuadratic, LUT_SEGMENTS, LUT_QUADRATIC);
+}
+
+static void initAtanLuts() {
+	initAtanLut(atanLutLinear,    LUT_SEGMENTS, LUT_LINEAR);
+	initAtanLut(atanLutQuadratic, LUT_SEGMENTS, LUT_QUADRATIC);
+}
+
+// everything needed to measure one function
+struct BenchEntry {
+	const char *name;
+	const char *tier;		// libm (4 scalar calls), sse, table-lin, or table-quad, and the -array tiers
+	float lo;				// the inputs are drawn uniformly from [lo, hi)
+	float hi;
+	BENCH_FUNC latency;		// NULL for the array tiers
+	BENCH_FUNC throughput;
+	BENCH_FUNC batch;
+	void (*init)();			// builds any tables the function needs, may be NULL
+};
+
+#define BENCH_ENTRY(name, tier, func, lo, hi, init) \
+	{ name, tier, lo, hi, benchLatency<func>, benchThroughput<func>, benchBatch<func>, init }
+
+#define ARRAY_ENTRY(name, tier, batch, lo, hi, init) \
+	{ name, tier, lo, hi, NULL, NULL, batch, init }
+
+static const BenchEntry BENCHES[] = {
+	BENCH_ENTRY("abs",        "libm",       abs_ref_loc,        -100.0f, 100.0f,  NULL),
+	BENCH_ENTRY("abs",        "sse",        abs_loc,            -100.0f, 100.0f,  NULL),
+	BENCH_ENTRY("trunc",      "libm",       trunc_ref_loc,      -100.0f, 100.0f,  NULL),
+	BENCH_ENTRY("trunc",      "sse",        trunc_loc,          -100.0f, 100.0f,  NULL),
+	BENCH_ENTRY("floor",      "libm",       floor_ref_loc,      -100.0f, 100.0f,  NULL),
+	BENCH_ENTRY("floor",      "sse",        floor_loc,          -100.0f, 100.0f,  NULL),
+	BENCH_ENTRY("ceil",       "libm",       ceil_ref_loc,       -100.0f, 100.0f,  NULL),
+	BENCH_ENTRY("ceil",       "sse",        ceil_loc,           -100.0f, 100.0f,  NULL),
+	BENCH_ENTRY("round",      "libm",       round_ref_loc,      -100.0f, 100.0f,  NULL),
+	BENCH_ENTRY("round",      "sse",        round_loc,          -100.0f, 100.0f,  NULL),
+	BENCH_ENTRY("wrap_angle", "libm",       wrap_angle_ref_loc, -100.0f, 100.0f,  NULL),
+	BENCH_ENTRY("wrap_angle", "sse",        wrap_angle_loc,     -100.0f, 100.0f,  NULL),
+	BENCH_ENTRY("exp",        "libm",       exp_ref_loc,        -80.0f,  80.0f,   NULL),
+	BENCH_ENTRY("exp",        "sse",        exp_loc,            -80.0f,  80.0f,   NULL),
+	BENCH_ENTRY("exp",        "table-lin",  exp_lut_lin_loc,    -80.0f,  80.0f,   initExpLuts),
+	BENCH_ENTRY("exp",        "table-quad", exp_lut_quad_loc,   -80.0f,  80.0f,   initExpLuts),
+	BENCH_ENTRY("sin",        "libm",       sin_ref_loc,        -100.0f, 100.0f,  NULL),
+	BENCH_ENTRY("sin",        "sse",        sin_loc,            -100.0f, 100.0f,  NULL),
+	BENCH_ENTRY("cos",        "libm",       cos_ref_loc,        -100.0f, 100.0f,  NULL),
+	BENCH_ENTRY("cos",        "sse",        cos_loc,            -100.0f, 100.0f,  NULL),
+	BENCH_ENTRY("sincos",     "libm",       sincos_ref_loc,     -100.0f, 100.0f,  NULL),
+	BENCH_ENTRY("sincos",     "sse",        sincos_loc,         -100.0f, 100.0f,  NULL),
+	BENCH_ENTRY("atan",       "libm",       atan_ref_loc,       -100.0f, 100.0f,  NULL),
+	BENCH_ENTRY("atan",       "sse",        atan_loc,           -100.0f, 100.0f,  NULL),
+	BENCH_ENTRY("atan",       "table-lin",  atan_lut_lin_loc,   -100.0f, 100.0f,  initAtanLuts),
+	BENCH_ENTRY("atan",       "table-quad", atan_lut_quad_loc,  -100.0f, 100.0f,  initAtanLuts),
+	BENCH_ENTRY("atan2",      "libm",       atan2_ref_loc,      -3.14f,  3.14f,   NULL),
+	BENCH_ENTRY("atan2",      "sse",        atan2_loc,          -3.14f,  3.14f,   NULL),
+	BENCH_ENTRY("lut",        "table-lin",  lut_lin_loc,        -0.35f,  0.35f,   initExpLuts),
+	BENCH_ENTRY("lut",        "table-quad", lut_quad_loc,       -0.35f,  0.35f,   initExpLuts),
+	ARRAY_ENTRY("lut",        "table-lin-array",  lut_lin_array,  -0.35f, 0.35f, initExpLuts),
+	ARRAY_ENTRY("lut",        "table-quad-array", lut_quad_array, -0.35f, 0.35f, initExpLuts),
+};
+
+#undef BENCH_ENTRY
+#undef ARRAY_ENTRY
+
+static const int NUM_BENCHES = sizeof(BENCHES) / sizeof(BENCHES[0]);
+
+
+//--- STATISTICS ---//
+
+static int compareDoubles(const void *a, const void *b) {
+	double da = *(const double *)a;
+	double db = *(const double *)b;
+	return (da < db) ? -1 : (da > db) ? 1 : 0;
+}
+
+// runs bench once to warm up the caches and the branch predictors,
+// then reps more times, and prints the statistics of those runs
+static void measure(BENCH_FUNC bench, const char *mode, const float *in, float *out,
+					int iters, double *samples, int reps)
+{
+	if (bench == NULL) {
+		printf("  %-10s %9s\n", mode, "n/a");
+		return;
+	}
+
+	bench(in, out, iters);
+
+	for (int r = 0; r < reps; r++) {
+		samples[r] = bench(in, out, iters);
+	}
+
+	qsort(samples, reps, sizeof(double), compareDoubles);
+
+	double sum = 0.0;
+	for (int r = 0; r < reps; r++) {
+		sum += samples[r];
+	}
+	double mean = sum / reps;
+
+	double var = 0.0;
+	for (int r = 0; r < reps; r++) {
+		var += (samples[r] - mean) * (samples[r] - mean);
+	}
+	double stddev = (reps > 1) ? sqrt(var / (reps - 1)) : 0.0;
+
+	printf("  %-10s %9.2f %9.2f %9.2f %9.2f\n", mode, samples[0], samples[reps / 2], mean, stddev);
+}
+
+
+//--- ENTRY POINT ---//
+
+static void listBenches() {
+	for (int i = 0; i < NUM_BENCHES; i++) {
+		printf("%-12s %s\n", BENCHES[i].name, BENCHES[i].tier);
+	}
+}
+
+static void usage() {
+	printf("usage: mathbench [-reps <n>] [-iters <n>] [-list] [func ...]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv) {
+	SSE::init();
+
+	int reps = DEFAULT_REPS;
+	int iters = DEFAULT_ITERS;
+	bool selected[NUM_BENCHES] = { false };
+	bool anySelected = false;
+
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		bool hasValue = (i + 1 < argc);
+
+		if (strcmp(arg, "-reps") == 0 && hasValue) {
+			reps = max(atoi(argv[++i]), 1);
+		} else if (strcmp(arg, "-iters") == 0 && hasValue) {
+			// a multiple of NUM_CHAINS, so every chain gets the same count
+			iters = max(atoi(argv[++i]) / NUM_CHAINS, 1) * NUM_CHAINS;
+		} else if (strcmp(arg, "-list") == 0) {
+			listBenches();
+			return 0;
+		} else {
+			bool found = false;
+			for (int b = 0; b < NUM_BENCHES; b++) {
+				if (strcmp(arg, BENCHES[b].name) == 0) {
+					selected[b] = true;
+					found = true;
+				}
+			}
+
+			if (!found) {
+				printf("unknown option or function: %s\n", arg);
+				usage();
+			}
+
+			anySelected = true;
+		}
+	}
+
+	float *in  = (float *)malloc16(sizeof(float) * BATCH_SIZE);
+	float *out = (float *)malloc16(sizeof(float) * BATCH_SIZE);
+	double *samples = new double[reps];
+
+#ifdef __AVX2__
+	printf("table lookups use AVX2 gathers\n");
+#else
+	printf("table lookups use SSE2 gathers\n");
+#endif
+	printf("counter rate: %.0f MHz, %d reps of %d calls\n",
+		   measureCyclesPerSecond() * 1.0e-6, reps, iters);
+	printf("latency is cycles per call, throughput and batch are cycles per element\n\n");
+
+	for (int b = 0; b < NUM_BENCHES; b++) {
+		const BenchEntry &e = BENCHES[b];
+
+		if (anySelected && !selected[b]) {
+			continue;
+		}
+
+		if (e.init != NULL) {
+			e.init();
+		}
+
+		// the same inputs for every tier of a function
+		seedRand(1);
+		for (int i = 0; i < BATCH_SIZE; i++) {
+			in[i] = getRand(e.lo, e.hi - e.lo);
+		}
+
+		printf("%s [%s]\n", e.name, e.tier);
+		printf("  %-10s %9s %9s %9s %9s\n", "mode", "min", "median", "mean", "stddev");
+		measure(e.latency,    "latency",    in, out, iters, samples, reps);
+		measure(e.throughput, "throughput", in, out, iters, samples, reps);
+		measure(e.batch,      "batch",      in, out, iters, samples, reps);
+		printf("\n");
+	}
+
+	delete[] samples;
+	free16(out);
+	free16(in);
+
+	if (numArrayMismatches > 0) {
+		printf("%d array lookup(s) of 4 elements did not match the 4-wide lookup\n",
+			   numArrayMismatches);
+		return 1;
+	}
+
+	return 0;
+}
+
+
+// end of mathbench.cpp
@@ -0,0 +1,495 @@
+// offline generator for the polynomial coefficients in sse/sseMath.h
+//
+// finds the minimax polynomial for a function on a given domain with the
+// Remez exchange algorithm, then rounds the coefficients to floats and
+// prints them as sseMath constants along with the max error that remains
+// after rounding
+//
+// usage: remez <func> <lo> <hi> <degree> [abs|rel] [full|odd|even]
+//
+//   func   - one of exp, sin, cos, atan, atan_euler
+//   lo, hi - the domain, for odd and even polynomials only [max(lo, 0), hi]
+//            is searched since the error is symmetric
+//   degree - highest power of x in the polynomial
+//   abs    - minimizes the max absolute error
+//   rel    - minimizes the max relative error (default)
+//   full   - all powers of x (default)
+//   odd    - only odd powers of x, for odd functions such as sin and atan
+//   even   - only even powers of x, for even functions such as cos
+//
+// examples, matching the helpers in sse/sseMath.h:
+//   remez exp -0.346574 0.346574 6 rel full      (__exp_mantissa)
+//   remez sin 0 1.570796 9 rel odd              (__sin_ror)
+//   remez atan_euler 0 0.5 6 rel full           (__atan_rd, in terms of z)
+//
+// if the exchange fails, the reason goes to stderr, nothing is printed to
+// stdout, and the program exits with a non-zero status
+//
+// everything is computed in long double, there are no dependencies
+// beyond the C runtime
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+
+typedef long double real;
+
+
+//--- CONSTANTS ---//
+
+static const int MAX_DEGREE = 16;
+static const int MAX_REF = MAX_DEGREE + 2;		// reference points per iteration
+
+static const int MAX_ITERS = 100;
+
+// number of samples used to locate the extrema of the error function
+static const int NUM_SAMPLES = 20000;
+
+// the exchange stops once the extrema agree to within this fraction
+static const real CONVERGED = 1.0e-9L;
+
+// stands in for zero where a function is evaluated as a limit
+static const real TINY = 1.0e-30L;
+
+static const real PI = 3.14159265358979323846264338327950288L;
+
+
+//--- TARGET FUNCTIONS ---//
+
+// atan(x) = q * S(z), with q = x / (1 + x*x) and z = x * q, is the form
+// used by __atan_rd(), this returns S(z) for z on [0, 1)
+static real atan_euler(real z) {
+	if (z < TINY) {
+		return 1.0L;
+	}
+
+	real x = sqrtl(z / (1.0L - z));
+	real q = x * (1.0L - z);		// 1 / (1 + x*x) == 1 - z
+	return atanl(x) / q;
+}
+
+static real exp_func(real x)  { return expl(x); }
+static real sin_func(real x)  { return sinl(x); }
+static real cos_func(real x)  { return cosl(x); }
+static real atan_func(real x) { return atanl(x); }
+
+typedef real (*REAL_FUNC)(real x);
+
+struct NamedFunc {
+	const char *name;
+	REAL_FUNC func;
+};
+
+static const NamedFunc FUNCS[] = {
+	{ "exp",        exp_func   },
+	{ "sin",        sin_func   },
+	{ "cos",        cos_func   },
+	{ "atan",       atan_func  },
+	{ "atan_euler", atan_euler }
+};
+static const int NUM_FUNCS = sizeof(FUNCS) / sizeof(NamedFunc);
+
+
+//--- PROBLEM ---//
+
+enum ErrorMetric {
+	ERR_ABS,
+	ERR_REL
+};
+
+enum PolyForm {
+	FORM_FULL,		// c0 + c1*x + c2*x^2 + ...
+	FORM_ODD,		// c1*x + c3*x^3 + ...
+	FORM_EVEN		// c0 + c2*x^2 + ...
+};
+
+// the problem is solved in terms of y, where y = x for full polynomials
+// and y = x*x for odd and even polynomials, which turns both into a
+// full polynomial Q(y) of a lower degree:
+//
+//   full: p(x) = Q(x)
+//   odd:  p(x) = x * Q(x*x)
+//   even: p(x) = Q(x*x)
+class Problem {
+public:
+	REAL_FUNC f;
+	ErrorMetric metric;
+	PolyForm form;
+	real lo, hi;	// domain of y
+	int n;			// degree of Q
+
+	// converts y back to x
+	real toX(real y) const {
+		return (form == FORM_FULL) ? y : sqrtl(y > TINY ? y : TINY);
+	}
+
+	// the function that Q(y) approximates
+	real target(real y) const {
+		real x = toX(y);
+		return (form == FORM_ODD) ? f(x) / x : f(x);
+	}
+
+	// the weight that turns the error of Q(y) into the error of p(x)
+	real weight(real y) const {
+		real x = toX(y);
+		real w = (metric == ERR_REL) ? 1.0L / fabsl(f(x)) : 1.0L;
+		return (form == FORM_ODD) ? w * x : w;
+	}
+};
+
+static real evalPoly(const real *c, int n, real y) {
+	real r = c[n];
+	for (int i = n - 1; i >= 0; i--) {
+		r = r * y + c[i];
+	}
+	return r;
+}
+
+// weighted error of the approximation at y
+static real errorAt(const Problem &p, const real *c, real y) {
+	return (p.target(y) - evalPoly(c, p.n, y)) * p.weight(y);
+}
+
+
+//--- LINEAR SOLVER ---//
+
+// solves the m x m system a * x = b in place with partial pivoting,
+// the solution is left in b, returns false if the matrix is singular
+static bool solve(real a[MAX_REF][MAX_REF], real *b, int m) {
+	for (int col = 0; col < m; col++) {
+		int piv = col;
+		for (int row = col + 1; row < m; row++) {
+			if (fabsl(a[row][col]) > fabsl(a[piv][col])) {
+				piv = row;
+			}
+		}
+		if (a[piv][col] == 0.0L) {
+			return false;
+		}
+
+		if (piv != col) {
+			for (int k = 0; k < m; k++) {
+				real t = a[col][k]; a[col][k] = a[piv][k]; a[piv][k] = t;
+			}
+			real t = b[col]; b[col] = b[piv]; b[piv] = t;
+		}
+
+		for (int row = col + 1; row < m; row++) {
+			real s = a[row][col] / a[col][col];
+			for (int k = col; k < m; k++) {
+				a[row][k] -= s * a[col][k];
+			}
+			b[row] -= s * b[col];
+		}
+	}
+
+	for (int row = m - 1; row >= 0; row--) {
+		real s = b[row];
+		for (int k = row + 1; k < m; k++) {
+			s -= a[row][k] * b[k];
+		}
+		b[row] = s / a[row][row];
+	}
+
+	return true;
+}
+
+
+//--- REMEZ EXCHANGE ---//
+
+// finds the coefficients c and levelled error e such that the weighted error
+// alternates in sign with magnitude e at the reference points
+static bool levelError(const Problem &p, const real *ref, real *c, real &e) {
+	int m = p.n + 2;
+	real a[MAX_REF][MAX_REF];
+	real b[MAX_REF];
+
+	for (int i = 0; i < m; i++) {
+		real y = ref[i];
+		real yk = 1.0L;
+		for (int k = 0; k <= p.n; k++) {
+			a[i][k] = yk;
+			yk *= y;
+		}
+		real sign = (i % 2 == 0) ? 1.0L : -1.0L;
+		a[i][p.n + 1] = sign / p.weight(y);
+		b[i] = p.target(y);
+	}
+
+	if (!solve(a, b, m)) {
+		return false;
+	}
+
+	for (int k = 0; k <= p.n; k++) {
+		c[k] = b[k];
+	}
+	e = b[p.n + 1];
+	return true;
+}
+
+// golden section search for the extremum of s * error on [a, b]
+static real refineExtremum(const Problem &p, const real *c, real s, real a, real b) {
+	static const real INV_PHI = 0.6180339887498948482L;
+
+	real x1 = b - INV_PHI * (b - a);
+	real x2 = a + INV_PHI * (b - a);
+	real f1 = s * errorAt(p, c, x1);
+	real f2 = s * errorAt(p, c, x2);
+
+	for (int i = 0; i < 100 && (b - a) > 1.0e-18L * (fabsl(a) + fabsl(b) + 1.0L); i++) {
+		if (f1 > f2) {
+			b = x2; x2 = x1; f2 = f1;
+			x1 = b - INV_PHI * (b - a);
+			f1 = s * errorAt(p, c, x1);
+		} else {
+			a = x1; x1 = x2; f1 = f2;
+			x2 = a + INV_PHI * (b - a);
+			f2 = s * errorAt(p, c, x2);
+		}
+	}
+
+	return (f1 > f2) ? x1 : x2;
+}
+
+// locates n + 2 alternating extrema of the error and stores them in ref,
+// returns the largest and smallest magnitudes among them
+static bool findExtrema(const Problem &p, const real *c, real *ref,
+					   real &max_err, real &min_err)
+{
+	static real pts[NUM_SAMPLES + 1];
+	static real errs[NUM_SAMPLES + 1];
+
+	// the extremum of each run of samples with the same sign
+	static real ext[NUM_SAMPLES + 1];
+	static real ext_err[NUM_SAMPLES + 1];
+	int num_ext = 0;
+
+	real h = (p.hi - p.lo) / NUM_SAMPLES;
+	for (int i = 0; i <= NUM_SAMPLES; i++) {
+		pts[i] = (i == NUM_SAMPLES) ? p.hi : p.lo + h * i;
+		errs[i] = errorAt(p, c, pts[i]);
+	}
+
+	int i = 0;
+	while (i <= NUM_SAMPLES) {
+		bool pos = errs[i] >= 0.0L;
+		int best = i;
+		int j = i;
+		while (j <= NUM_SAMPLES && (errs[j] >= 0.0L) == pos) {
+			if (fabsl(errs[j]) > fabsl(errs[best])) {
+				best = j;
+			}
+			j++;
+		}
+
+		// refine between the neighboring samples, endpoints stay put
+		real y = pts[best];
+		if (best > 0 && best < NUM_SAMPLES) {
+			y = refineExtremum(p, c, pos ? 1.0L : -1.0L, pts[best - 1], pts[best + 1]);
+		}
+
+		ext[num_ext] = y;
+		ext_err[num_ext] = errorAt(p, c, y);
+		num_ext++;
+		i = j;
+	}
+
+	int m = p.n + 2;
+	if (num_ext < m) {
+		return false;
+	}
+
+	// any m consecutive extrema alternate, keep the window that contains
+	// the largest error and has the largest smallest error
+	int global = 0;
+	for (int k = 1; k < num_ext; k++) {
+		if (fabsl(ext_err[k]) > fabsl(ext_err[global])) {
+			global = k;
+		}
+	}
+
+	int best_start = -1;
+	real best_min = -1.0L;
+	for (int start = 0; start + m <= num_ext; start++) {
+		if (global < start || global >= start + m) {
+			continue;
+		}
+		real wmin = fabsl(ext_err[start]);
+		for (int k = start + 1; k < start + m; k++) {
+			wmin = fabsl(ext_err[k]) < wmin ? fabsl(ext_err[k]) : wmin;
+		}
+		if (wmin > best_min) {
+			best_min = wmin;
+			best_start = start;
+		}
+	}
+
+	for (int k = 0; k < m; k++) {
+		ref[k] = ext[best_start + k];
+	}
+	max_err = fabsl(ext_err[global]);
+	min_err = best_min;
+	return true;
+}
+
+// runs the exchange, returns false if it fails to converge, the last
+// iteration of an exchange that did not converge is not minimax and can
+// be far worse than it, so it is not returned either
+static bool remez(const Problem &p, real *c, real &max_err) {
+	int m = p.n + 2;
+	real ref[MAX_REF];
+
+	// start from the Chebyshev extrema, which are close to optimal
+	for (int i = 0; i < m; i++) {
+		real t = cosl(PI * (m - 1 - i) / (m - 1));
+		ref[i] = p.lo + (p.hi - p.lo) * 0.5L * (t + 1.0L);
+	}
+
+	for (int iter = 0; iter < MAX_ITERS; iter++) {
+		real e;
+		if (!levelError(p, ref, c, e)) {
+			fprintf(stderr, "singular system at iteration %d\n", iter);
+			return false;
+		}
+
+		real min_err;
+		if (!findExtrema(p, c, ref, max_err, min_err)) {
+			fprintf(stderr, "lost the alternation at iteration %d\n", iter);
+			return false;
+		}
+
+		if (max_err - min_err <= CONVERGED * max_err) {
+			return true;
+		}
+	}
+
+	fprintf(stderr, "did not converge after %d iterations\n", MAX_ITERS);
+	return false;
+}
+
+
+//--- OUTPUT ---//
+
+static unsigned int floatBits(float f) {
+	unsigned int u;
+	memcpy(&u, &f, sizeof(u));
+	return u;
+}
+
+// max weighted error over a dense sampling, with the coefficients
+// rounded to floats
+static real roundedError(const Problem &p, const real *c) {
+	real cf[MAX_DEGREE + 1];
+	for (int k = 0; k <= p.n; k++) {
+		cf[k] = (float)c[k];
+	}
+
+	real max_err = 0.0L;
+	static const int NUM_CHECKS = NUM_SAMPLES * 10;
+	for (int i = 0; i <= NUM_CHECKS; i++) {
+		real y = p.lo + (p.hi - p.lo) * i / NUM_CHECKS;
+		real err = fabsl(errorAt(p, cf, y));
+		max_err = (err > max_err) ? err : max_err;
+	}
+	return max_err;
+}
+
+static void printConstants(const Problem &p, const char *func_name,
+						   real lo_x, real hi_x, int degree,
+						   const real *c, real max_err)
+{
+	const char *metric = (p.metric == ERR_REL) ? "relative" : "absolute";
+	real rounded = roundedError(p, c);
+
+	printf("// minimax approximation of %s on [%Lg, %Lg]\n", func_name, lo_x, hi_x);
+	printf("// degree %d, max %s error %.3Le (2^%.1Lf), %.3Le (2^%.1Lf) after rounding\n",
+		   degree, metric, max_err, log2l(max_err), rounded, log2l(rounded));
+
+	for (int k = 0; k <= p.n; k++) {
+		int power = (p.form == FORM_FULL) ? k
+				  : (p.form == FORM_ODD)  ? 2 * k + 1
+				  :                         2 * k;
+		float cf = (float)c[k];
+		printf("\tsse4Floats c%d = reint_i2f(sse4Ints::expand(0x%08x));\t// % .6ef\n",
+			   power, floatBits(cf), cf);
+	}
+}
+
+
+//--- ENTRY POINT ---//
+
+static void usage() {
+	printf("usage: remez <func> <lo> <hi> <degree> [abs|rel] [full|odd|even]\n");
+	printf("funcs:");
+	for (int i = 0; i < NUM_FUNCS; i++) {
+		printf(" %s", FUNCS[i].name);
+	}
+	printf("\n");
+	exit(1);
+}
+
+int main(int argc, char **argv) {
+	if (argc < 5) {
+		usage();
+	}
+
+	Problem p;
+	p.f = NULL;
+	for (int i = 0; i < NUM_FUNCS; i++) {
+		if (strcmp(argv[1], FUNCS[i].name) == 0) {
+			p.f = FUNCS[i].func;
+		}
+	}
+	if (p.f == NULL) {
+		printf("unknown function \"%s\"\n", argv[1]);
+		usage();
+	}
+
+	real lo_x = strtold(argv[2], NULL);
+	real hi_x = strtold(argv[3], NULL);
+	int degree = atoi(argv[4]);
+
+	p.metric = ERR_REL;
+	p.form = FORM_FULL;
+	for (int i = 5; i < argc; i++) {
+		if      (strcmp(argv[i], "abs")  == 0) { p.metric = ERR_ABS;   }
+		else if (strcmp(argv[i], "rel")  == 0) { p.metric = ERR_REL;   }
+		else if (strcmp(argv[i], "full") == 0) { p.form   = FORM_FULL; }
+		else if (strcmp(argv[i], "odd")  == 0) { p.form   = FORM_ODD;  }
+		else if (strcmp(argv[i], "even") == 0) { p.form   = FORM_EVEN; }
+		else { usage(); }
+	}
+
+	if (!(lo_x < hi_x) || degree < 0 || degree > MAX_DEGREE) {
+		usage();
+	}
+
+	if (p.form == FORM_FULL) {
+		p.lo = lo_x;
+		p.hi = hi_x;
+		p.n = degree;
+	} else {
+		real a = (lo_x > 0.0L) ? lo_x : 0.0L;
+		p.lo = a * a;
+		p.hi = hi_x * hi_x;
+		p.n = (p.form == FORM_ODD) ? (degree - 1) / 2 : degree / 2;
+
+		if (p.form == FORM_ODD && degree < 1) {
+			usage();
+		}
+	}
+
+	real c[MAX_DEGREE + 1];
+	real max_err;
+	if (!remez(p, c, max_err)) {
+		return 1;
+	}
+
+	printConstants(p, argv[1], lo_x, hi_x, degree, c, max_err);
+	return 0;
+}
+
+
+// end of remez.cpp
@@ -0,0 +1,706 @@
+// multithreaded accuracy validator for the SSE math functions
+//
+// sweeps every normal float in a domain, measures the error of each result
+// in units in the last place (ULPs) against a double precision reference,
+// and checks a fixed set of special values (zeros, denormals, infinities,
+// NaNs), the program exits with a non-zero status if any function exceeds
+// its error threshold
+//
+// usage: ulpcheck [options] [func ...]
+//   -threads <n>    number of worker threads, defaults to the number of processors
+//   -lo <x>         start of the domain, overrides the default of each function
+//   -hi <x>         end of the domain, overrides the default of each function
+//   -max-ulp <u>    error threshold, overrides the default of each function
+//   -list           lists the functions with their tier, domain, and threshold
+//
+// if no functions are named, all of them are checked, functions of two
+// arguments sweep the first one against each of a fixed list of second ones
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sys/common.h"
+#include "sys/Thread.h"
+#include "sys/Timer.h"
+
+#include "sse/sseMath.h"
+#include "sse/sseLut.h"
+
+
+typedef sse4Floats (*ONE_ARG_FUNC)(sse4Floats x);
+typedef double (*REF_FUNC)(double x);
+typedef sse4Floats (*TWO_ARG_FUNC)(sse4Floats x, sse4Floats y);
+typedef double (*REF_FUNC_2)(double x, double y);
+
+// number of segments in each of the lookup tables, same as Comparison.cpp
+static const int LUT_SEGMENTS = 256;
+
+// number of inputs handed to a worker at a time
+static const unsigned int CHUNK_SIZE = 1 << 16;
+
+// histogram buckets: exact, <= 0.5, <= 1, <= 2, ... <= 2^20, and anything worse
+static const int MAX_BUCKET_LOG2 = 20;
+static const int NUM_BUCKETS = MAX_BUCKET_LOG2 + 4;
+
+static const double DOUBLE_PI = 3.14159265358979323846;
+
+static sseLut expLutLinear;
+static sseLut expLutQuadratic;
+static sseLut atanLutLinear;
+static sseLut atanLutQuadratic;
+
+
+//--- FLOAT BITS ---//
+
+static forceinline unsigned int toBits(float f) {
+	return *(unsigned int *)&f;
+}
+
+static forceinline float fromBits(unsigned int u) {
+	return *(float *)&u;
+}
+
+// SSE::init() sets the unit to treat denormals as zero, so that is
+// also what the reference sees
+static forceinline float flushDenormal(float f) {
+	return (fabsf(f) < FLT_MIN) ? fromBits(toBits(f) & 0x80000000) : f;
+}
+
+
+//--- FUNCTIONS UNDER TEST ---//
+
+static sse4Floats abs_loc(sse4Floats x)           { return abs(x); }
+static sse4Floats trunc_loc(sse4Floats x)         { return trunc(x); }
+static sse4Floats floor_loc(sse4Floats x)         { return floor(x); }
+static sse4Floats ceil_loc(sse4Floats x)          { return ceil(x); }
+static sse4Floats round_loc(sse4Floats x)         { return round(x); }
+static sse4Floats wrap_angle_loc(sse4Floats x)    { return wrap_angle(x); }
+static sse4Floats exp_loc(sse4Floats x)           { return exp(x); }
+static sse4Floats sin_loc(sse4Floats x)           { return sin(x); }
+static sse4Floats cos_loc(sse4Floats x)           { return cos(x); }
+static sse4Floats sincos_s_loc(sse4Floats x)      { sse4Floats s, c; sincos(x, s, c); return s; }
+static sse4Floats sincos_c_loc(sse4Floats x)      { sse4Floats s, c; sincos(x, s, c); return c; }
+static sse4Floats atan_loc(sse4Floats x)          { return atan(x); }
+static sse4Floats exp_lut_lin_loc(sse4Floats x)   { return exp_lut(expLutLinear, x); }
+static sse4Floats exp_lut_quad_loc(sse4Floats x)  { return exp_lut(expLutQuadratic, x); }
+static sse4Floats atan_lut_lin_loc(sse4Floats x)  { return atan_lut(atanLutLinear, x); }
+static sse4Floats atan_lut_quad_loc(sse4Floats x) { return atan_lut(atanLutQuadratic, x); }
+
+static sse4Floats fmod_loc(sse4Floats x, sse4Floats y) { return fmod(x, y); }
+
+
+//--- REFERENCE FUNCTIONS ---//
+
+static double abs_dbl(double x)   { return fabs(x); }
+static double floor_dbl(double x) { return floor(x); }
+static double ceil_dbl(double x)  { return ceil(x); }
+static double exp_dbl(double x)   { return exp(x); }
+static double sin_dbl(double x)   { return sin(x); }
+static double cos_dbl(double x)   { return cos(x); }
+static double atan_dbl(double x)  { return atan(x); }
+static double fmod_dbl(double x, double y) { return fmod(x, y); }
+
+static double trunc_dbl(double x) {
+	return (x < 0.0) ? ceil(x) : floor(x);
+}
+
+// halfway cases round away from zero, x + 0.5 is exact for any float x
+static double round_dbl(double x) {
+	return (x < 0.0) ? -floor(0.5 - x) : floor(x + 0.5);
+}
+
+// wrap_angle() clamps its result to the float closest to PI
+static double wrap_angle_dbl(double x) {
+	double r = fmod(x, 2.0 * DOUBLE_PI);
+	if (r >  DOUBLE_PI) r -= 2.0 * DOUBLE_PI;
+	if (r < -DOUBLE_PI) r += 2.0 * DOUBLE_PI;
+
+	double pi_f = (float)DOUBLE_PI;
+	return (r > pi_f) ? pi_f : (r < -pi_f) ? -pi_f : r;
+}
+
+
+//--- TABLE SETUP ---//
+
+static void initExpLuts() {
+	initExpLut(expLutLinear,    LUT_SEGMENTS, LUT_LINEAR);
+	initExpLut(expLutQuadratic, LUT_SEGMENTS, LUT_QUADRATIC);
+}
+
+static void initAtanLuts() {
+	initAtanLut(atanLutLinear,    LUT_SEGMENTS, LUT_LINEAR);
+	initAtanLut(atanLutQuadratic, LUT_SEGMENTS, LUT_QUADRATIC);
+}
+
+
+//--- FUNCTION TABLE ---//
+
+// everything needed to check one function
+struct FuncEntry {
+	const char *name;
+	const char *tier;		// exact, poly, or table
+	ONE_ARG_FUNC func;
+	REF_FUNC ref;
+	float lo;				// default domain, same as the compare functions in Comparison.cpp
+	float hi;
+	float errFloor;			// errors are measured in ULPs of max(|ref|, errFloor)
+	double period;			// results that differ by a multiple of this are equal, 0 if none
+	double maxUlp;			// regression threshold
+	bool checkSpecials;		// if true, a mismatch on a special value is a regression
+	void (*init)();			// builds any tables the function needs, may be NULL
+	TWO_ARG_FUNC func2;		// set instead of func and ref for functions of two arguments,
+	REF_FUNC_2 ref2;		// and left out of the entries of the others
+};
+
+// the second arguments a function of two arguments is swept against, 2*PI and
+// 32.66 both have first arguments for which their float quotient rounds up to
+// an integer
+static const float SECOND_ARGS[] = { 6.2831853f, 32.66f, 1.5f, -0.1f };
+
+static const int NUM_SECOND_ARGS = sizeof(SECOND_ARGS) / sizeof(SECOND_ARGS[0]);
+
+// the thresholds are the measured errors with a little headroom:
+// - sin and cos are only accurate in absolute terms near their zeros, and cos
+//   also loses ulp(x) when adding PI/2, so those measure against ulp(1)
+// - wrap_angle is accurate in absolute terms, so it measures against ulp(4),
+//   and PI and -PI are the same angle
+// - atan is off by up to 0.34% around |x| = 1
+// - the table versions of exp and atan are limited by the size of the tables
+// - fmod is exact while the quotient is below 2^24, which the domain keeps it to
+static const FuncEntry FUNCS[] = {
+	{ "abs",           "exact", abs_loc,           abs_dbl,        NEGINF,   INF,     0.0f,    0.0,           0.0,     true,  NULL         },
+	{ "trunc",         "exact", trunc_loc,         trunc_dbl,      NEGINF,   INF,     0.0f,    0.0,           0.0,     true,  NULL         },
+	{ "floor",         "exact", floor_loc,         floor_dbl,      NEGINF,   INF,     0.0f,    0.0,           0.0,     true,  NULL         },
+	{ "ceil",          "exact", ceil_loc,          ceil_dbl,       NEGINF,   INF,     0.0f,    0.0,           0.0,     true,  NULL         },
+	{ "round",         "exact", round_loc,         round_dbl,      NEGINF,   INF,     0.0f,    0.0,           0.0,     true,  NULL         },
+	{ "wrap_angle",    "poly",  wrap_angle_loc,    wrap_angle_dbl, -1000.0f, 1000.0f, 4.0f,    2.0*DOUBLE_PI, 1.0,     false, NULL         },
+	{ "exp",           "poly",  exp_loc,           exp_dbl,        -80.0f,   80.0f,   0.0f,    0.0,           80.0,    false, NULL         },
+	{ "sin",           "poly",  sin_loc,           sin_dbl,        -100.0f,  100.0f,  1.0f,    0.0,           1.5,     false, NULL         },
+	{ "cos",           "poly",  cos_loc,           cos_dbl,        -100.0f,  100.0f,  1.0f,    0.0,           32.0,    false, NULL         },
+	{ "sincos.sin",    "poly",  sincos_s_loc,      sin_dbl,        -100.0f,  100.0f,  1.0f,    0.0,           1.5,     false, NULL         },
+	{ "sincos.cos",    "poly",  sincos_c_loc,      cos_dbl,        -100.0f,  100.0f,  1.0f,    0.0,           1.5,     false, NULL         },
+	{ "atan",          "poly",  atan_loc,          atan_dbl,       NEGINF,   INF,     0.0f,    0.0,           48000.0, true,  NULL         },
+	{ "exp_lut_lin",   "table", exp_lut_lin_loc,   exp_dbl,        -80.0f,   80.0f,   0.0f,    0.0,           20.0,    false, initExpLuts  },
+	{ "exp_lut_quad",  "table", exp_lut_quad_loc,  exp_dbl,        -80.0f,   80.0f,   0.0f,    0.0,           2.5,     false, initExpLuts  },
+	{ "atan_lut_lin",  "table", atan_lut_lin_loc,  atan_dbl,       NEGINF,   INF,     0.0f,    0.0,           96.0,    true,  initAtanLuts },
+	{ "atan_lut_quad", "table", atan_lut_quad_loc, atan_dbl,       NEGINF,   INF,     0.0f,    0.0,           40.0,    true,  initAtanLuts },
+	{ "fmod",          "exact", NULL,              NULL,           -1000.0f, 1000.0f, 0.0f,    0.0,           0.0,     true,  NULL,        fmod_loc, fmod_dbl },
+};
+
+static const int NUM_FUNCS = sizeof(FUNCS) / sizeof(FUNCS[0]);
+
+
+//--- ERROR MEASUREMENT ---//
+
+// the error of val in ULPs of the float closest to ref (or of errFloor if that is larger),
+// a NaN or infinity that does not match the reference is reported as INF
+static double ulpError(float val, double ref, float errFloor, double period) {
+	float ref_f = flushDenormal((float)ref);
+
+	if (isnan(val) || ref != ref) {
+		return (isnan(val) && ref != ref) ? 0.0 : INF;
+	}
+
+	if (!finite(val) || !finite(ref_f)) {
+		return (val == ref_f) ? 0.0 : INF;
+	}
+
+	// a flushed result is exact if the reference also flushes
+	if (val == ref_f) {
+		return 0.0;
+	}
+
+	double diff = fabs(val - ref);
+	if (period != 0.0 && diff > 0.5 * period) {
+		diff = fabs(diff - period);
+	}
+
+	double mag = fabs(ref);
+	if (mag < errFloor) mag = errFloor;
+	if (mag < FLT_MIN)  mag = FLT_MIN;
+
+	// ulp of a float on [2^(e-1), 2^e) is 2^(e-24)
+	int e;
+	frexp(mag, &e);
+	return diff / ldexp(1.0, e - 24);
+}
+
+static int bucketOf(double ulps) {
+	if (ulps == 0.0) return 0;
+	if (ulps <= 0.5) return 1;
+
+	for (int k = 0; k <= MAX_BUCKET_LOG2; k++) {
+		if (ulps <= ldexp(1.0, k)) {
+			return k + 2;
+		}
+	}
+
+	return NUM_BUCKETS - 1;
+}
+
+// the running error state of a sweep
+struct UlpStats {
+	double count;
+	double sumUlp;
+	double maxUlp;
+	unsigned int worstBits;		// input with the largest error, lowest one on ties
+	float worstY;				// second argument of that input, if any
+	float worstVal;
+	double worstRef;
+	double hist[NUM_BUCKETS];
+
+	UlpStats() : count(0.0), sumUlp(0.0), maxUlp(-1.0), worstBits(0), worstY(0.0f),
+				 worstVal(0.0f), worstRef(0.0)
+	{
+		for (int i = 0; i < NUM_BUCKETS; i++) {
+			hist[i] = 0.0;
+		}
+	}
+
+	void add(unsigned int bits, float y, float val, double ref, double ulps) {
+		count += 1.0;
+		hist[bucketOf(ulps)] += 1.0;
+
+		if (finite((float)ulps)) {
+			sumUlp += ulps;
+		}
+
+		if (ulps > maxUlp || (ulps == maxUlp && bits < worstBits)) {
+			maxUlp = ulps;
+			worstBits = bits;
+			worstY = y;
+			worstVal = val;
+			worstRef = ref;
+		}
+	}
+
+	// the result does not depend on the order of the merges, except for
+	// the last digits of the average
+	void merge(const UlpStats &rhs) {
+		count  += rhs.count;
+		sumUlp += rhs.sumUlp;
+
+		for (int i = 0; i < NUM_BUCKETS; i++) {
+			hist[i] += rhs.hist[i];
+		}
+
+		if (rhs.maxUlp > maxUlp || (rhs.maxUlp == maxUlp && rhs.worstBits < worstBits)) {
+			maxUlp    = rhs.maxUlp;
+			worstBits = rhs.worstBits;
+			worstY    = rhs.worstY;
+			worstVal  = rhs.worstVal;
+			worstRef  = rhs.worstRef;
+		}
+	}
+};
+
+
+//--- SWEEP ---//
+
+// the normals in a domain, as a positive run of bit patterns followed by a negative run
+struct Domain {
+	unsigned int posStart, numPos;
+	unsigned int negStart, numNeg;
+
+	// normals between lo and hi, the bound farther from zero is excluded like
+	// in Comparison.cpp
+	Domain(float lo, float hi) {
+		float posLo = max(lo, FLT_MIN);
+		float negHi = min(hi, -FLT_MIN);
+
+		posStart = toBits(posLo);
+		negStart = toBits(negHi);
+		numPos = (hi > posLo) ? toBits(hi) - posStart : 0;
+		numNeg = (lo < negHi) ? toBits(lo) - negStart : 0;
+	}
+
+	double size() const {
+		return (double)numPos + numNeg;
+	}
+
+	unsigned int numChunks() const {
+		return (numPos + CHUNK_SIZE - 1) / CHUNK_SIZE + (numNeg + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	}
+
+	// the bit patterns of chunk c, the positive chunks come first
+	void getChunk(unsigned int c, unsigned int &start, unsigned int &count) const {
+		unsigned int posChunks = (numPos + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+		unsigned int base = posStart, num = numPos;
+		if (c >= posChunks) {
+			c -= posChunks;
+			base = negStart;
+			num = numNeg;
+		}
+
+		start = base + c * CHUNK_SIZE;
+		count = num - c * CHUNK_SIZE;
+		if (count > CHUNK_SIZE) {
+			count = CHUNK_SIZE;
+		}
+	}
+};
+
+// shared between the workers of a sweep
+struct SweepJob {
+	const FuncEntry *entry;
+	const Domain *domain;
+	volatile int nextChunk;
+};
+
+// per-worker state, padded so that workers do not share cache lines
+struct SweepWorker {
+	SweepJob *job;
+	UlpStats stats;
+	char pad[64];
+};
+
+static void sweepChunk(const FuncEntry &e, unsigned int start, unsigned int count, UlpStats &stats) {
+	for (unsigned int i = 0; i < count; i += SSE_WIDTH) {
+		// the last group of a chunk repeats its final input to fill the vector
+		unsigned int bits[SSE_WIDTH];
+		for (int j = 0; j < SSE_WIDTH; j++) {
+			bits[j] = start + ((i + j < count) ? i + j : count - 1);
+		}
+
+		sse4Floats x = sse4Floats(fromBits(bits[0]), fromBits(bits[1]),
+								  fromBits(bits[2]), fromBits(bits[3]));
+		int n = min(SSE_WIDTH, (int)(count - i));
+
+		if (e.func2 == NULL) {
+			sse4Floats val = e.func(x);
+
+			for (int j = 0; j < n; j++) {
+				double ref = e.ref(x[j]);
+				stats.add(bits[j], 0.0f, val[j], ref, ulpError(val[j], ref, e.errFloor, e.period));
+			}
+			continue;
+		}
+
+		for (int k = 0; k < NUM_SECOND_ARGS; k++) {
+			float y = SECOND_ARGS[k];
+			sse4Floats val = e.func2(x, sse4Floats::expand(y));
+
+			for (int j = 0; j < n; j++) {
+				double ref = e.ref2(x[j], y);
+				stats.add(bits[j], y, val[j], ref, ulpError(val[j], ref, e.errFloor, e.period));
+			}
+		}
+	}
+}
+
+static void sweepThread(void *arg) {
+	SweepWorker *w = (SweepWorker *)arg;
+	SweepJob *job = w->job;
+
+	// the control register is per-thread
+	SSE::init();
+
+	unsigned int numChunks = job->domain->numChunks();
+	for (;;) {
+		unsigned int c = (unsigned int)atomicAdd(&job->nextChunk, 1);
+		if (c >= numChunks) {
+			break;
+		}
+
+		unsigned int start, count;
+		job->domain->getChunk(c, start, count);
+		sweepChunk(*job->entry, start, count, w->stats);
+	}
+}
+
+// checks every normal in the domain on numThreads threads
+static UlpStats sweep(const FuncEntry &e, const Domain &domain, int numThreads) {
+	SweepJob job;
+	job.entry = &e;
+	job.domain = &domain;
+	job.nextChunk = 0;
+
+	SweepWorker *workers = new SweepWorker[numThreads];
+	Thread *threads = new Thread[numThreads];
+
+	for (int i = 0; i < numThreads; i++) {
+		workers[i].job = &job;
+		threads[i].start(sweepThread, &workers[i]);
+	}
+
+	UlpStats total;
+	for (int i = 0; i < numThreads; i++) {
+		threads[i].join();
+		total.merge(workers[i].stats);
+	}
+
+	delete[] threads;
+	delete[] workers;
+	return total;
+}
+
+
+//--- SPECIAL VALUES ---//
+
+static const unsigned int SPECIALS[] = {
+	0x00000000, 0x80000000,		// +0, -0
+	0x00000001, 0x80000001,		// smallest denormals
+	0x007fffff, 0x807fffff,		// largest denormals
+	0x00800000, 0x80800000,		// smallest normals
+	0x7f7fffff, 0xff7fffff,		// largest normals
+	0x7f800000, 0xff800000,		// INF, NEGINF
+	0x7fc00000, 0xffc00000		// quiet NaNs
+};
+
+static const int NUM_SPECIALS = sizeof(SPECIALS) / sizeof(SPECIALS[0]);
+
+// the pairs for functions of two arguments, the largest normals are left
+// out, since they need a quotient far beyond what fmod is exact for
+static const unsigned int SPECIAL_PAIRS[][2] = {
+	{ 0x00000000, 0x40c90fdb }, { 0x80000000, 0x40c90fdb },		// +0, -0 by 2*PI
+	{ 0x00000001, 0x40c90fdb }, { 0x807fffff, 0x40c90fdb },		// denormals by 2*PI
+	{ 0x00800000, 0x40c90fdb }, { 0x80800000, 0x40c90fdb },		// smallest normals by 2*PI
+	{ 0x7f800000, 0x40c90fdb }, { 0xff800000, 0x40c90fdb },		// INF, NEGINF by 2*PI
+	{ 0x7fc00000, 0x40c90fdb }, { 0x40400000, 0x7fc00000 },		// NaN by 2*PI, 3 by NaN
+	{ 0x40400000, 0x00000000 }, { 0x40400000, 0x80000000 },		// 3 by +0, -0
+	{ 0x40400000, 0x00000001 }, { 0xc0400000, 0x807fffff },		// 3, -3 by denormals
+	{ 0x40400000, 0x7f800000 }, { 0xc0400000, 0xff800000 },		// 3, -3 by INF, NEGINF
+	{ 0x7f800000, 0x7f800000 }, { 0x80000000, 0x7f800000 },		// INF, -0 by INF
+	{ 0x448716a7, 0x40c90fdb }, { 0x42c3f5c3, 0x4202a3d7 }		// 1080.70789 by 2*PI, 97.98 by 32.66
+};
+
+static const int NUM_SPECIAL_PAIRS = sizeof(SPECIAL_PAIRS) / sizeof(SPECIAL_PAIRS[0]);
+
+// the special pairs that do not match the reference, a zero with the
+// wrong sign is a mismatch here, as fmod keeps the sign of x
+static int checkSpecialPairs(const FuncEntry &e, double maxUlp) {
+	int numBad = 0;
+
+	for (int i = 0; i < NUM_SPECIAL_PAIRS; i += SSE_WIDTH) {
+		float in_x[SSE_WIDTH], in_y[SSE_WIDTH];
+		for (int j = 0; j < SSE_WIDTH; j++) {
+			int k = min(i + j, NUM_SPECIAL_PAIRS - 1);
+			in_x[j] = fromBits(SPECIAL_PAIRS[k][0]);
+			in_y[j] = fromBits(SPECIAL_PAIRS[k][1]);
+		}
+
+		sse4Floats x = sse4Floats(in_x[0], in_x[1], in_x[2], in_x[3]);
+		sse4Floats y = sse4Floats(in_y[0], in_y[1], in_y[2], in_y[3]);
+		sse4Floats val = e.func2(x, y);
+
+		int n = min(SSE_WIDTH, NUM_SPECIAL_PAIRS - i);
+		for (int j = 0; j < n; j++) {
+			double ref = e.ref2(flushDenormal(x[j]), flushDenormal(y[j]));
+			double ulps = ulpError(val[j], ref, e.errFloor, e.period);
+			if (val[j] == 0.0f && ref == 0.0 && (toBits(val[j]) >> 31) != (unsigned int)toInt(signbit(ref) != 0)) {
+				ulps = INF;
+			}
+
+			if (ulps > maxUlp) {
+				printf("  special 0x%08x (%g), 0x%08x (%g): got %g (0x%08x), expected %g\n",
+					   toBits(x[j]), x[j], toBits(y[j]), y[j], val[j], toBits(val[j]), ref);
+				numBad++;
+			}
+		}
+	}
+
+	return numBad;
+}
+
+// returns the number of special values that do not match the reference
+static int checkSpecials(const FuncEntry &e, double maxUlp) {
+	if (e.func2 != NULL) {
+		return checkSpecialPairs(e, maxUlp);
+	}
+
+	int numBad = 0;
+
+	for (int i = 0; i < NUM_SPECIALS; i += SSE_WIDTH) {
+		float in[SSE_WIDTH];
+		for (int j = 0; j < SSE_WIDTH; j++) {
+			in[j] = fromBits(SPECIALS[min(i + j, NUM_SPECIALS - 1)]);
+		}
+
+		sse4Floats x = sse4Floats(in[0], in[1], in[2], in[3]);
+		sse4Floats val = e.func(x);
+
+		int n = min(SSE_WIDTH, NUM_SPECIALS - i);
+		for (int j = 0; j < n; j++) {
+			double ref = e.ref(flushDenormal(x[j]));
+			double ulps = ulpError(val[j], ref, e.errFloor, e.period);
+
+			if (ulps > maxUlp) {
+				printf("  special 0x%08x (%g): got %g (0x%08x), expected %g\n",
+					   toBits(x[j]), x[j], val[j], toBits(val[j]), ref);
+				numBad++;
+			}
+		}
+	}
+
+	return numBad;
+}
+
+
+//--- REPORTING ---//
+
+static void printHistogram(const UlpStats &stats) {
+	static const char *LABELS[NUM_BUCKETS] = {
+		"0", "<= 0.5", "<= 1", "<= 2", "<= 4", "<= 8", "<= 16", "<= 32", "<= 64",
+		"<= 128", "<= 256", "<= 512", "<= 1K", "<= 2K", "<= 4K", "<= 8K", "<= 16K",
+		"<= 32K", "<= 64K", "<= 128K", "<= 256K", "<= 512K", "<= 1M", "> 1M"
+	};
+
+	for (int i = 0; i < NUM_BUCKETS; i++) {
+		if (stats.hist[i] > 0.0) {
+			printf("  %-8s ulp: %12.0f (%8.4f%%)\n", LABELS[i], stats.hist[i],
+				   100.0 * stats.hist[i] / stats.count);
+		}
+	}
+}
+
+static void listFuncs() {
+	printf("%-14s %-6s %-26s %s\n", "func", "tier", "domain", "max ulp");
+	for (int i = 0; i < NUM_FUNCS; i++) {
+		const FuncEntry &e = FUNCS[i];
+		printf("%-14s %-6s (%11g, %11g) %g%s%s\n", e.name, e.tier, e.lo, e.hi,
+			   e.maxUlp, e.checkSpecials ? "" : " (specials not checked)",
+			   (e.func2 != NULL) ? " (two arguments)" : "");
+	}
+}
+
+static void usage() {
+	printf("usage: ulpcheck [-threads <n>] [-lo <x>] [-hi <x>] [-max-ulp <u>] [-list] [func ...]\n");
+	exit(2);
+}
+
+
+//--- ENTRY POINT ---//
+
+int main(int argc, char **argv) {
+	SSE::init();
+
+	int numThreads = Thread::getNumProcessors();
+	bool hasLo = false, hasHi = false, hasMaxUlp = false;
+	float lo = 0.0f, hi = 0.0f;
+	double maxUlp = 0.0;
+	bool selected[NUM_FUNCS] = { false };
+	bool anySelected = false;
+
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		bool hasValue = (i + 1 < argc);
+
+		if (strcmp(arg, "-threads") == 0 && hasValue) {
+			numThreads = max(atoi(argv[++i]), 1);
+		} else if (strcmp(arg, "-lo") == 0 && hasValue) {
+			lo = (float)atof(argv[++i]);
+			hasLo = true;
+		} else if (strcmp(arg, "-hi") == 0 && hasValue) {
+			hi = (float)atof(argv[++i]);
+			hasHi = true;
+		} else if (strcmp(arg, "-max-ulp") == 0 && hasValue) {
+			maxUlp = atof(argv[++i]);
+			hasMaxUlp = true;
+		} else if (strcmp(arg, "-list") == 0) {
+			listFuncs();
+			return 0;
+		} else {
+			int f = 0;
+			while (f < NUM_FUNCS && strcmp(arg, FUNCS[f].name) != 0) {
+				f++;
+			}
+
+			if (f == NUM_FUNCS) {
+				printf("unknown option or function: %s\n", arg);
+				usage();
+			}
+
+			selected[f] = true;
+			anySelected = true;
+		}
+	}
+
+	printf("checking with %d thread(s)\n\n", numThreads);
+
+	int numFailed = 0;
+	bool passed[NUM_FUNCS];
+	double measured[NUM_FUNCS];
+
+	for (int f = 0; f < NUM_FUNCS; f++) {
+		const FuncEntry &e = FUNCS[f];
+		passed[f] = true;
+
+		if (anySelected && !selected[f]) {
+			continue;
+		}
+
+		if (e.init != NULL) {
+			e.init();
+		}
+
+		float fLo = hasLo ? lo : e.lo;
+		float fHi = hasHi ? hi : e.hi;
+		double fMaxUlp = hasMaxUlp ? maxUlp : e.maxUlp;
+
+		if (!(fLo < fHi)) {
+			printf("the domain is empty\n");
+			usage();
+		}
+
+		printf("=================================================\n");
+		printf("%s [%s] on (%g, %g)\n", e.name, e.tier, fLo, fHi);
+		printf("=================================================\n");
+
+		Timer t;
+		t.start();
+
+		Domain domain(fLo, fHi);
+		UlpStats stats = sweep(e, domain, numThreads);
+
+		t.stop();
+
+		measured[f] = stats.maxUlp;
+		if (stats.count > 0.0) {
+			printf("max error: %g ulp at x = %g (0x%08x)", stats.maxUlp,
+				   fromBits(stats.worstBits), stats.worstBits);
+			if (e.func2 != NULL) {
+				printf(", y = %g", stats.worstY);
+			}
+			printf(", got %g, expected %.9g\n", stats.worstVal, stats.worstRef);
+			printf("avg error: %g ulp over %.0f inputs\n", stats.sumUlp / stats.count, stats.count);
+			printHistogram(stats);
+		}
+
+		int numSpecials = (e.func2 != NULL) ? NUM_SPECIAL_PAIRS : NUM_SPECIALS;
+		int numBadSpecials = checkSpecials(e, fMaxUlp);
+		printf("special values: %d of %d match%s\n", numSpecials - numBadSpecials,
+			   numSpecials, e.checkSpecials ? "" : " (not checked)");
+
+		passed[f] = (stats.maxUlp <= fMaxUlp) && (!e.checkSpecials || numBadSpecials == 0);
+		numFailed += toInt(!passed[f]);
+
+		printf("time: %f sec\n\n", t.getElapsedSeconds());
+		fflush(stdout);
+	}
+
+	// summary of the functions that were checked
+	printf("%-14s %-6s %12s %12s\n", "func", "tier", "max ulp", "threshold");
+	for (int f = 0; f < NUM_FUNCS; f++) {
+		if (anySelected && !selected[f]) {
+			continue;
+		}
+
+		double fMaxUlp = hasMaxUlp ? maxUlp : FUNCS[f].maxUlp;
+		printf("%-14s %-6s %12g %12g  %s\n", FUNCS[f].name, FUNCS[f].tier,
+			   measured[f], fMaxUlp, passed[f] ? "ok" : "FAILED");
+	}
+
+	if (numFailed > 0) {
+		printf("\n%d function(s) regressed\n", numFailed);
+		return 1;
+	}
+
+	return 0;
+}
+
+
+// end of ulpcheck.cpp
@@ -156,6 +156,21 @@ public:
 		return temp2[0];
 	}
 
+	// the largest of the 4 components
+	forceinline float reduce_max() const {
+		sse4Floats temp1 = _mm_max_ps(data, shuffle<1, 0, 3, 2>().data);
+		sse4Floats temp2 = _mm_max_ps(temp1.data, temp1.shuffle<2, 3, 0, 1>().data);
+		return _mm_cvtss_f32(temp2.data);
+	}
+
+	//--- SCAN ---//
+
+	// the running sums of the 4 components, (a, a+b, a+b+c, a+b+c+d)
+	forceinline sse4Floats scan_add() const {
+		sse4Floats temp1 = operator +(sse4Floats(_mm_slli_si128(reint(data), 4)));
+		return temp1 + sse4Floats(_mm_slli_si128(reint(temp1.data), 8));
+	}
+
 	//--- PRINT ---//
 	void print() const {
 		printf("(% f, % f, % f, % f)", operator [](0), operator [](1),